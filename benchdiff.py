@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+
+# Compare two `make bench` JSON outputs (bin/bench.json) by CPU time.
+# Flags benchmarks slower by more than `threshold` percent (default 10),
+# and exits with 1 if any.
+# ex: cp bin/bench.json base.json; (change, make); make bench; ./benchdiff.py base.json bin/bench.json
+
+import json
+import sys
+
+def load(path):
+    with open(path) as f:
+        runs = json.load(f)["benchmarks"]
+    ret = {}
+    for run in runs:
+        if run.get("error_occurred"):
+            continue
+        # with repetitions, compare medians
+        if run.get("run_type") == "aggregate":
+            if run.get("aggregate_name") != "median":
+                continue
+            ret[run["run_name"]] = run["cpu_time"]
+        elif run["name"] not in ret:
+            ret[run["name"]] = run["cpu_time"]
+    return ret
+
+if len(sys.argv) < 3:
+    sys.exit("usage: benchdiff.py old.json new.json [threshold%]")
+
+old = load(sys.argv[1])
+new = load(sys.argv[2])
+threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 10
+regressions = 0
+
+print(f"{'Benchmark':<40} {'old':>12} {'new':>12} {'change':>8}")
+for name in old:
+    if name not in new:
+        continue
+    change = (new[name] - old[name]) / old[name] * 100
+    flag = ""
+    if change > threshold:
+        flag = "  REGRESSION"
+        regressions += 1
+    print(f"{name:<40} {old[name]:>12.1f} {new[name]:>12.1f} {change:>+7.1f}%{flag}")
+
+for name in sorted(set(old) ^ set(new)):
+    print(f"{name:<40} only in {'old' if name in old else 'new'}")
+
+if regressions:
+    print(f"{regressions} regression(s) over {threshold}%")
+    sys.exit(1)
@@ -1,5 +1,8 @@
 #include <benchmark/benchmark.h>
 #include "utilcpp.h"
+#include "buffet.hpp"
+#include <algorithm>
+#include <unordered_map>
 
 extern "C" {
 #include <stdio.h>
@@ -30,6 +33,69 @@ const char *SPLITME =
 "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" SEP "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb" SEP \
 "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" SEP "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb" SEP;
 
+//=============================================================================
+// Allocation counting : malloc, calloc and realloc are interposed (glibc),
+// so counts cover the lib, libstdc++ and raw C alike. A realloc counts as
+// one allocation of its new size. Allocations inside libc itself (strdup..)
+// are not seen.
+// COUNT_ALLOCS, placed before the timing loop, reports allocs/iter and 
+// bytes/iter from there to the end of the benchmark.
+#ifdef __GLIBC__
+
+static size_t alloc_cnt = 0;
+static size_t alloc_bytes = 0;
+
+// plain counts : the benchmarks are single-threaded
+#define ALLOC_COUNT(size) do { \
+    ++alloc_cnt; \
+    alloc_bytes += (size); \
+} while(0)
+
+extern "C" {
+void* __libc_malloc (size_t size);
+void* __libc_calloc (size_t cnt, size_t size);
+void* __libc_realloc (void *ptr, size_t size);
+
+void* malloc (size_t size) noexcept {
+    ALLOC_COUNT(size);
+    return __libc_malloc(size);
+}
+void* calloc (size_t cnt, size_t size) noexcept {
+    ALLOC_COUNT(cnt*size);
+    return __libc_calloc(cnt, size);
+}
+void* realloc (void *ptr, size_t size) noexcept {
+    ALLOC_COUNT(size);
+    return __libc_realloc(ptr, size);
+}
+}
+
+class AllocCounter {
+
+public:
+
+    explicit AllocCounter (benchmark::State &state) 
+    : state(state), cnt(alloc_cnt), bytes(alloc_bytes) {}
+
+    ~AllocCounter () {
+        using benchmark::Counter;
+        state.counters["allocs/iter"] = 
+            Counter(alloc_cnt - cnt, Counter::kAvgIterations);
+        state.counters["bytes/iter"] = 
+            Counter(alloc_bytes - bytes, Counter::kAvgIterations);
+    }
+
+private:
+
+    benchmark::State &state;
+    size_t cnt, bytes;
+};
+
+#define COUNT_ALLOCS AllocCounter _allocs(state);
+#else
+#define COUNT_ALLOCS
+#endif
+
 //=============================================================================
 #define GETLEN \
     const size_t len = state.range(0);\
@@ -40,6 +106,7 @@ MEMCOPY_c (benchmark::State& state)
 {
     GETLEN
 
+    COUNT_ALLOCS
     for (auto _ : state) {
         char *buf = (char*)malloc(len+1);
         benchmark::DoNotOptimize(buf);
@@ -55,6 +122,7 @@ MEMCOPY_buffet (benchmark::State& state)
 {
     GETLEN
 
+    COUNT_ALLOCS
     for (auto _ : state) {
         Buffet buf = bft_memcopy(alpha, len);
         benchmark::DoNotOptimize(buf);
@@ -69,6 +137,7 @@ MEMVIEW_cpp (benchmark::State& state)
 {
     GETLEN
 
+    COUNT_ALLOCS
     for (auto _ : state) {
         auto buf = string_view(alpha, len);
         benchmark::DoNotOptimize(buf);
@@ -81,6 +150,7 @@ MEMVIEW_buffet (benchmark::State& state)
 {
     GETLEN
 
+    COUNT_ALLOCS
     for (auto _ : state) {
         Buffet buf = bft_memview(alpha, len);
         benchmark::DoNotOptimize(buf);
@@ -88,6 +158,195 @@ MEMVIEW_buffet (benchmark::State& state)
     }
 }
  
+//=============================================================================
+// Copy a payload : deep for std::string, shared until mutation for Buffet.
+static void
+COPY_cpp (benchmark::State& state) 
+{
+    GETLEN
+    const string src(alpha, len);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        string cpy = src;
+        benchmark::DoNotOptimize(cpy);
+    }
+}
+
+static void
+COPY_buffet (benchmark::State& state) 
+{
+    GETLEN
+    Buffet src = bft_memcopy(alpha, len);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        Buffet cpy = bft_copyall(&src);
+        benchmark::DoNotOptimize(cpy);
+        bft_free(&cpy);
+    }
+
+    bft_free(&src);
+}
+
+//=============================================================================
+// Rewrite a field in the middle of a buffer : replace, then restore.
+static void
+EDIT_cpp (benchmark::State& state) 
+{
+    GETLEN
+    string buf(alpha, len);
+    const size_t off = len/2;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        buf.replace(off, 4, "value");
+        buf.replace(off, 5, "four");
+        buf[0] = '#';
+        benchmark::DoNotOptimize(buf.data());
+    }
+}
+
+static void
+EDIT_buffet (benchmark::State& state) 
+{
+    GETLEN
+    Buffet buf = bft_memcopy(alpha, len);
+    const size_t off = len/2;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        bft_overwrite(&buf, off, "valu", 4);
+        bft_insert(&buf, off+4, "e", 1);
+        bft_erase(&buf, off+4, 1);
+        bft_setbyte(&buf, 0, '#');
+        benchmark::DoNotOptimize(bft_data(&buf));
+    }
+
+    bft_free(&buf);
+}
+
+//=============================================================================
+// Hot accessors over mixed SSO/OWN/VUE Buffets.
+// _call names the exported functions, _inline gets the buffet.h fast paths.
+// Compare with `LTO=1 make`, which lets the calls inline too.
+#define ACCESS_INIT \
+    vector<Buffet> bufs(1024); \
+    for (size_t i = 0; i < bufs.size(); ++i) { \
+        switch (i%3) { \
+            case 0: bufs[i] = bft_memcopy(alpha+i%64, 8); break; \
+            case 1: bufs[i] = bft_memcopy(alpha+i%64, 40); break; \
+            case 2: bufs[i] = bft_memview(alpha+i%64, 40); break; \
+        } \
+    }
+
+#define ACCESS_END \
+    for (auto &buf : bufs) bft_free(&buf); \
+    state.SetItemsProcessed(state.iterations() * bufs.size());
+
+static void 
+ACCESS_call (benchmark::State& state) 
+{
+    ACCESS_INIT
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (auto &buf : bufs) sum += (bft_len)(&buf) + (bft_data)(&buf)[0];
+        benchmark::DoNotOptimize(sum);
+    }
+    ACCESS_END
+}
+
+static void 
+ACCESS_inline (benchmark::State& state) 
+{
+    ACCESS_INIT
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (auto &buf : bufs) sum += bft_len(&buf) + bft_data(&buf)[0];
+        benchmark::DoNotOptimize(sum);
+    }
+    ACCESS_END
+}
+
+// known tag : VUE dup/free fold to copies
+static void 
+DUPFREE_call (benchmark::State& state) 
+{
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        Buffet src = (bft_memview)(alpha, 40);
+        Buffet cpy = (bft_dup)(&src);
+        benchmark::DoNotOptimize(cpy);
+        (bft_free)(&cpy);
+        (bft_free)(&src);
+    }
+}
+
+static void 
+DUPFREE_inline (benchmark::State& state) 
+{
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        Buffet src = bft_memview(alpha, 40);
+        Buffet cpy = bft_dup(&src);
+        benchmark::DoNotOptimize(cpy);
+        bft_free(&cpy);
+        bft_free(&src);
+    }
+}
+
+//=============================================================================
+// Request-scoped strings on a monotonic resource : build, append, teardown.
+#define PMR_COUNT 1000
+
+static void
+PMR_string (benchmark::State& state)
+{
+    GETLEN
+    char mem[1<<18];
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(mem, sizeof(mem));
+        {
+            std::pmr::vector<std::pmr::string> strs(&arena);
+            strs.reserve(PMR_COUNT);
+            for (int i = 0; i < PMR_COUNT; ++i) {
+                strs.emplace_back(alpha+i%64, len);
+                strs.back().append(alpha, 8);
+            }
+            benchmark::DoNotOptimize(strs.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * PMR_COUNT);
+}
+
+static void
+PMR_buffet (benchmark::State& state)
+{
+    GETLEN
+    char mem[1<<18];
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(mem, sizeof(mem));
+        bft::PmrAllocator bftmem(&arena);
+        bft::AllocatorScope scope(bftmem);
+        {
+            std::pmr::vector<bft::Buffet> strs(&arena);
+            strs.reserve(PMR_COUNT);
+            for (int i = 0; i < PMR_COUNT; ++i) {
+                strs.emplace_back(alpha+i%64, len);
+                strs.back().append(alpha, 8);
+            }
+            benchmark::DoNotOptimize(strs.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * PMR_COUNT);
+}
+
 //=============================================================================
 #define APPEND_INIT \
     const size_t initlen = state.range(0);\
@@ -99,6 +358,7 @@ APPEND_cpp (benchmark::State& state)
 {
     APPEND_INIT
 
+    COUNT_ALLOCS
     for (auto _ : state) {
     auto dst = string(alpha, initlen);
         string_view more = string_view(alpha+initlen, appnlen);
@@ -113,6 +373,7 @@ APPEND_buffet (benchmark::State& state)
 {
     APPEND_INIT
 
+    COUNT_ALLOCS
     for (auto _ : state) {
     Buffet dst = bft_memview(alpha, initlen);
         benchmark::DoNotOptimize(dst);
@@ -126,6 +387,7 @@ APPEND_buffet (benchmark::State& state)
 static void 
 SPLITJOIN_c (benchmark::State& state) 
 {
+    COUNT_ALLOCS
     for (auto _ : state) {
         int cnt = 0;
         char** parts = split(SPLITME, sep, &cnt);
@@ -141,6 +403,7 @@ SPLITJOIN_c (benchmark::State& state)
 static void 
 SPLITJOIN_cpp (benchmark::State& state) 
 {
+    COUNT_ALLOCS
     for (auto _ : state) {
         vector<string_view> parts = split_cppview(SPLITME, sep);
         const char* ret = join_cppview(parts, sep);
@@ -153,6 +416,7 @@ SPLITJOIN_cpp (benchmark::State& state)
 static void 
 SPLITJOIN_buffet (benchmark::State& state) 
 {
+    COUNT_ALLOCS
     for (auto _ : state) {
         int cnt = 0;
         Buffet *parts = bft_splitstr(SPLITME, sep, &cnt);
@@ -165,42 +429,1341 @@ SPLITJOIN_buffet (benchmark::State& state)
     }
 }
 
+//=============================================================================
+// Tokenize and consume : total length of non-empty parts.
+// The range adapters find parts on demand, split_cppview builds them all first.
+static void 
+SPLITSCAN_cppview (benchmark::State& state) 
+{
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t total = 0;
+        for (auto part : split_cppview(SPLITME, sep))
+            if (!part.empty()) total += part.size();
+        benchmark::DoNotOptimize(total);
+    }
+}
 
-//=====================================================================
-#define MEMCOPY(one, two) \
-BENCHMARK(one)->Arg(8); \
-BENCHMARK(two)->Arg(8); \
-BENCHMARK(one)->Arg(32); \
-BENCHMARK(two)->Arg(32); \
-BENCHMARK(one)->Arg(128); \
-BENCHMARK(two)->Arg(128); \
-BENCHMARK(one)->Arg(512); \
-BENCHMARK(two)->Arg(512); \
-BENCHMARK(one)->Arg(2048); \
-BENCHMARK(two)->Arg(2048); \
-BENCHMARK(one)->Arg(8192); \
-BENCHMARK(two)->Arg(8192); \
+static void 
+SPLITSCAN_buffet (benchmark::State& state) 
+{
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt = 0;
+        Buffet *parts = bft_splitstr(SPLITME, sep, &cnt);
+        size_t total = 0;
+        for (int i = 0; i < cnt; ++i) total += bft_len(&parts[i]);
+        benchmark::DoNotOptimize(total);
+        free(parts);
+    }
+}
 
-#define MEMVIEW(one, two) \
-BENCHMARK(one)->Arg(8); \
-BENCHMARK(two)->Arg(8); \
+static void 
+SPLITSCAN_range (benchmark::State& state) 
+{
+    const string_view src(SPLITME);
 
-#define APPEND(one, two) \
-BENCHMARK(one)->Args({8,4});\
-BENCHMARK(two)->Args({8,4});\
-BENCHMARK(one)->Args({8,16});\
-BENCHMARK(two)->Args({8,16});\
-BENCHMARK(one)->Args({24,4});\
-BENCHMARK(two)->Args({24,4});\
-BENCHMARK(one)->Args({24,32});\
-BENCHMARK(two)->Args({24,32});\
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t total = 0;
+        for (auto len : bft::split_view(src, sep)
+                      | std::views::filter([](string_view p) {return !p.empty();})
+                      | std::views::transform([](string_view p) {return p.size();}))
+            total += len;
+        benchmark::DoNotOptimize(total);
+    }
+}
 
-MEMVIEW (MEMVIEW_cpp, MEMVIEW_buffet);
-MEMCOPY (MEMCOPY_c, MEMCOPY_buffet);
-APPEND (APPEND_cpp, APPEND_buffet);
-BENCHMARK(SPLITJOIN_c);
-BENCHMARK(SPLITJOIN_cpp);
-BENCHMARK(SPLITJOIN_buffet);
+// first part only : the lazy view stops early
+static void 
+SPLITFIRST_cppview (benchmark::State& state) 
+{
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        auto parts = split_cppview(SPLITME, sep);
+        benchmark::DoNotOptimize(parts.front());
+    }
+}
+
+static void 
+SPLITFIRST_range (benchmark::State& state) 
+{
+    const string_view src(SPLITME);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        auto first = *bft::split_view(src, sep).begin();
+        benchmark::DoNotOptimize(first);
+    }
+}
+
+
+//=============================================================================
+// Split of request lines by each kernel tier, as BUFFET_FORCE_ISA would select.
+// Arg : separator length
+static string
+request_lines (size_t size)
+{
+    static const char *paths[] = {"/", "/api/v1/users", "/static/app.js", 
+        "/img/logo-large.png", "/search?q=buffet&page=2"};
+    string ret;
+    for (unsigned i = 0; ret.size() < size; ++i) {
+        ret += "GET ";
+        ret += paths[i%5];
+        ret += " HTTP/1.1\r\nHost: example.com\r\n";
+    }
+    return ret;
+}
+
+static void 
+SPLITISA (benchmark::State& state, const char *isa) 
+{
+    static const char *seps[] = {"", "\n", "\r\n", "", "Host", "", "", "", "HTTP/1.1"};
+    const string src = request_lines(1<<16);
+    const char *sep = seps[state.range(0)];
+
+    if (!bft_set_isa(isa)) {
+        state.SkipWithError("unsupported");
+        return;
+    }
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt;
+        Buffet *parts = bft_split(src.data(), src.size(), sep, strlen(sep), &cnt);
+        benchmark::DoNotOptimize(parts);
+        free(parts);
+    }
+
+    bft_set_isa(NULL);
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+
+//=============================================================================
+// Key-length distribution : {length, weight}.
+// Edit to match your data, then compare builds `SIZE=24|32|64 make`.
+static const struct {size_t len; int weight;} KEYLENS[] = {
+    {8, 5}, {16, 10}, {24, 20}, {32, 25}, {40, 20}, {48, 12}, {60, 8}
+};
+
+// deterministic key lengths following KEYLENS
+static vector<size_t>
+keylens (size_t cnt)
+{
+    int total = 0;
+    for (auto &k : KEYLENS) total += k.weight;
+
+    vector<size_t> ret(cnt);
+    unsigned seed = 42;
+    for (auto &len : ret) {
+        seed = seed*1103515245 + 12345;
+        int pick = (seed >> 16) % total;
+        for (auto &k : KEYLENS) {
+            if ((pick -= k.weight) < 0) {len = k.len; break;}
+        }
+    }
+    return ret;
+}
+
+// Create and free keys.
+// Counters : share of SSO keys, heap bytes per key.
+static void 
+KEYS_cpp (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<string> keys(lens.size());
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < lens.size(); ++i)
+            keys[i] = string(alpha+i%64, lens[i]);
+        benchmark::DoNotOptimize(keys.data());
+        for (auto &k : keys) string().swap(k);
+    }
+
+    // inline if the data lies within the handle
+    size_t sso = 0;
+    size_t heap = 0;
+    for (size_t i = 0; i < lens.size(); ++i) {
+        const string key(alpha+i%64, lens[i]);
+        const char *data = key.data();
+        if (data >= (const char*)&key && data < (const char*)(&key+1)) ++sso;
+        else heap += key.capacity()+1;
+    }
+
+    state.counters["sso"] = (double)sso / lens.size();
+    state.counters["heap/key"] = (double)heap / lens.size();
+    state.counters["handle"] = sizeof(string);
+}
+
+static void 
+KEYS_buffet (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<Buffet> keys(lens.size());
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < lens.size(); ++i)
+            keys[i] = bft_memcopy(alpha+i%64, lens[i]);
+        benchmark::DoNotOptimize(keys.data());
+        for (auto &k : keys) bft_free(&k);
+    }
+
+    size_t sso = 0;
+    size_t heap = 0;
+    for (size_t i = 0; i < lens.size(); ++i) {
+        Buffet key = bft_memcopy(alpha+i%64, lens[i]);
+        const size_t retained = bft_retained(&key);
+        sso += !retained;
+        heap += retained;
+        bft_free(&key);
+    }
+
+    state.counters["sso"] = (double)sso / lens.size();
+    state.counters["heap/key"] = (double)heap / lens.size();
+    state.counters["handle"] = sizeof(Buffet);
+}
+
+// Compare neighbour keys : handles traffic depends on handle size.
+static void 
+KEYSCAN_cpp (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<string> keys(lens.size());
+    for (size_t i = 0; i < lens.size(); ++i)
+        keys[i] = string(alpha+i%64, lens[i]);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int sum = 0;
+        for (size_t i = 1; i < keys.size(); ++i)
+            sum += (keys[i-1].compare(keys[i]) < 0);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+static void 
+KEYSCAN_buffet (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<Buffet> keys(lens.size());
+    for (size_t i = 0; i < lens.size(); ++i)
+        keys[i] = bft_memcopy(alpha+i%64, lens[i]);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int sum = 0;
+        for (size_t i = 1; i < keys.size(); ++i)
+            sum += (bft_cmp(&keys[i-1], &keys[i]) < 0);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+
+    for (auto &k : keys) bft_free(&k);
+}
+
+// same through the C++ wrapper
+static void 
+KEYSCAN_wrapper (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<bft::Buffet> keys;
+    keys.reserve(lens.size());
+    for (size_t i = 0; i < lens.size(); ++i)
+        keys.emplace_back(alpha+i%64, lens[i]);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int sum = 0;
+        for (size_t i = 1; i < keys.size(); ++i)
+            sum += (keys[i-1] < keys[i]);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+//=============================================================================
+// Owning views on fixed-size tokens of a store
+#define TOKENS_INIT \
+    const size_t cnt = state.range(0); \
+    const size_t toklen = 16; \
+    Buffet src = bft_memcopy(alpha, cnt*toklen); \
+    vector<size_t> offs(cnt), lens(cnt, toklen); \
+    vector<Buffet> toks(cnt); \
+    for (size_t i = 0; i < cnt; ++i) offs[i] = i*toklen;
+
+static void 
+TOKENS_view (benchmark::State& state) 
+{
+    TOKENS_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < cnt; ++i) 
+            toks[i] = bft_view(&src, offs[i], lens[i]);
+        benchmark::DoNotOptimize(toks.data());
+        for (auto &t : toks) bft_free(&t);
+    }
+
+    bft_free(&src);
+}
+
+static void 
+TOKENS_views (benchmark::State& state) 
+{
+    TOKENS_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        bft_views(&src, offs.data(), lens.data(), cnt, toks.data());
+        benchmark::DoNotOptimize(toks.data());
+        for (auto &t : toks) bft_free(&t);
+    }
+
+    bft_free(&src);
+}
+
+//=============================================================================
+// Load a column of keys : one store per key, or one packed store.
+static void 
+LOAD_buffet (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<const char*> srcs(lens.size());
+    vector<Buffet> keys(lens.size());
+    for (size_t i = 0; i < lens.size(); ++i) srcs[i] = alpha+i%64;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < lens.size(); ++i)
+            keys[i] = bft_memcopy(srcs[i], lens[i]);
+        benchmark::DoNotOptimize(keys.data());
+        for (auto &k : keys) bft_free(&k);
+    }
+}
+
+static void 
+LOAD_buffet_many (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<const char*> srcs(lens.size());
+    vector<Buffet> keys(lens.size());
+    for (size_t i = 0; i < lens.size(); ++i) srcs[i] = alpha+i%64;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        bft_memcopy_many(srcs.data(), lens.data(), lens.size(), keys.data());
+        benchmark::DoNotOptimize(keys.data());
+        for (auto &k : keys) bft_free(&k);
+    }
+}
+
+//=============================================================================
+// Memory per string of 24 and 16 bytes handles, for short strings.
+// Arg : max string length (lengths cycle over 0..max)
+// Counters : handle, heap and total bytes per string
+
+#define FOOTPRINT_COUNT (1<<16)
+
+static void 
+FOOTPRINT_buffet (benchmark::State& state) 
+{
+    const size_t maxlen = state.range(0);
+    vector<Buffet> strs(FOOTPRINT_COUNT);
+    size_t heap = 0;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        heap = 0;
+        for (size_t i = 0; i < strs.size(); ++i) {
+            strs[i] = bft_memcopy(alpha+i%64, i%(maxlen+1));
+            heap += bft_retained(&strs[i]);
+        }
+        benchmark::DoNotOptimize(strs.data());
+        for (auto &b : strs) bft_free(&b);
+    }
+
+    state.counters["handle"] = sizeof(Buffet);
+    state.counters["heap/str"] = (double)heap / strs.size();
+    state.counters["bytes/str"] = sizeof(Buffet) + (double)heap / strs.size();
+}
+
+static void 
+FOOTPRINT_compact (benchmark::State& state) 
+{
+    const size_t maxlen = state.range(0);
+    vector<BuffetCompact> strs(FOOTPRINT_COUNT);
+    size_t heap = 0;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        heap = 0;
+        for (size_t i = 0; i < strs.size(); ++i) {
+            strs[i] = bftc_memcopy(alpha+i%64, i%(maxlen+1));
+            heap += bftc_retained(&strs[i]);
+        }
+        benchmark::DoNotOptimize(strs.data());
+        for (auto &b : strs) bftc_free(&b);
+    }
+
+    state.counters["handle"] = sizeof(BuffetCompact);
+    state.counters["heap/str"] = (double)heap / strs.size();
+    state.counters["bytes/str"] = sizeof(BuffetCompact) + (double)heap / strs.size();
+}
+
+//=============================================================================
+// Column of keys against an array of Buffets : scan, sort, lookup.
+// Counter : bytes per string (handle or offset, heap)
+
+#define COLUMN_INIT \
+    const auto lens = keylens(state.range(0)); \
+    const size_t cnt = lens.size(); \
+    vector<Buffet> keys(cnt); \
+    for (size_t i = 0; i < cnt; ++i) \
+        keys[i] = bft_memcopy(alpha+(i*37)%64, lens[i]); \
+    BuffetColumn col; \
+    if (!bft_column_from(&col, keys.data(), cnt)) \
+        state.SkipWithError("bft_column_from");
+
+#define COLUMN_END \
+    for (auto &k : keys) bft_free(&k); \
+    bft_column_free(&col);
+
+static inline bool
+buflt (const Buffet &a, const Buffet &b) {
+    return bft_cmp(&a, &b) < 0;
+}
+
+static inline int
+colcmp (const BuffetColumn *col, size_t i, const Buffet *key)
+{
+    Buffet vue = bft_column_get(col, i);
+    return bft_cmp(&vue, key);
+}
+
+static void
+COLSCAN_buffets (benchmark::State& state)
+{
+    COLUMN_INIT
+    size_t heap = 0;
+    for (auto &k : keys) heap += bft_retained(&k);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (auto &k : keys) sum += bft_len(&k) + bft_data(&k)[0];
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * cnt);
+    state.counters["bytes/str"] = sizeof(Buffet) + (double)heap / cnt;
+
+    COLUMN_END
+}
+
+static void
+COLSCAN_column (benchmark::State& state)
+{
+    COLUMN_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (size_t i = 0; i < cnt; ++i) {
+            Buffet vue = bft_column_get(&col, i);
+            sum += bft_len(&vue) + bft_data(&vue)[0];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * cnt);
+    state.counters["bytes/str"] = sizeof(BuffetColumnOff)
+        + (double)col.datacap / cnt;
+
+    COLUMN_END
+}
+
+static void
+COLSORT_buffets (benchmark::State& state)
+{
+    COLUMN_INIT
+    vector<Buffet> sorted(cnt);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        sorted = keys; // handles only, keys keep ownership
+        std::sort(sorted.begin(), sorted.end(), buflt);
+        benchmark::DoNotOptimize(sorted.data());
+    }
+    state.SetItemsProcessed(state.iterations() * cnt);
+
+    COLUMN_END
+}
+
+static void
+COLSORT_column (benchmark::State& state)
+{
+    COLUMN_INIT
+    vector<uint32_t> order(cnt);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < cnt; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+            Buffet vb = bft_column_get(&col, b);
+            return colcmp(&col, a, &vb) < 0;
+        });
+        benchmark::DoNotOptimize(order.data());
+    }
+    state.SetItemsProcessed(state.iterations() * cnt);
+
+    COLUMN_END
+}
+
+// lookup every key in the sorted set by binary search
+static void
+COLFIND_buffets (benchmark::State& state)
+{
+    COLUMN_INIT
+    vector<Buffet> sorted = keys;
+    std::sort(sorted.begin(), sorted.end(), buflt);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t found = 0;
+        for (auto &k : keys) {
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), k, buflt);
+            found += !bft_cmp(&*it, &k);
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * cnt);
+
+    COLUMN_END
+}
+
+static void
+COLFIND_column (benchmark::State& state)
+{
+    COLUMN_INIT
+    vector<Buffet> sorted = keys;
+    std::sort(sorted.begin(), sorted.end(), buflt);
+    BuffetColumn scol;
+    if (!bft_column_from(&scol, sorted.data(), cnt))
+        state.SkipWithError("bft_column_from");
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t found = 0;
+        for (auto &k : keys) {
+            size_t lo = 0, hi = cnt;
+            while (lo < hi) {
+                size_t mid = (lo+hi)/2;
+                if (colcmp(&scol, mid, &k) < 0) lo = mid+1; else hi = mid;
+            }
+            found += !colcmp(&scol, lo, &k);
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * cnt);
+
+    bft_column_free(&scol);
+    COLUMN_END
+}
+
+//=============================================================================
+// Sorted paths, as memcopy'd Buffets or a front-coded dict : lookup latency.
+// Counter : bytes per key (handle and heap)
+
+static vector<Buffet>
+sortedpaths (size_t cnt)
+{
+    static const char *dirs[] = {"assets/img", "api/v1/users", "api/v2/orders", "docs"};
+    vector<Buffet> ret(cnt);
+    char tmp[128];
+
+    for (size_t i = 0; i < cnt; ++i) {
+        int len = snprintf(tmp, sizeof(tmp), "https://example.com/%s/%08zu/index.html", 
+            dirs[i%4], i*2654435761u % cnt);
+        ret[i] = bft_memcopy(tmp, len);
+    }
+    std::sort(ret.begin(), ret.end(), buflt);
+    return ret;
+}
+
+static void
+DICTFIND_buffets (benchmark::State& state)
+{
+    auto keys = sortedpaths(state.range(0));
+    size_t heap = 0;
+    for (auto &k : keys) heap += bft_retained(&k);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t found = 0;
+        for (size_t i = 0; i < keys.size(); i += 7) {
+            auto it = std::lower_bound(keys.begin(), keys.end(), keys[i], buflt);
+            found += it - keys.begin();
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * (keys.size()+6)/7);
+    state.counters["bytes/key"] = sizeof(Buffet) + (double)heap / keys.size();
+
+    for (auto &k : keys) bft_free(&k);
+}
+
+static void
+DICTFIND_dict (benchmark::State& state)
+{
+    auto keys = sortedpaths(state.range(0));
+    BuffetDict dict = bft_dict_from(keys.data(), keys.size());
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t found = 0;
+        for (size_t i = 0; i < keys.size(); i += 7) 
+            found += bft_dict_find(&dict, &keys[i]);
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * (keys.size()+6)/7);
+    state.counters["bytes/key"] = (double)bft_dict_retained(&dict) / keys.size();
+
+    bft_dict_free(&dict);
+    for (auto &k : keys) bft_free(&k);
+}
+
+//=============================================================================
+// Lookup among sorted paths : hashing, binary search, radix trie.
+
+#define ART_INIT \
+    auto keys = sortedpaths(state.range(0)); \
+    vector<size_t> order(keys.size()); \
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i*2654435761u % keys.size();
+
+#define ART_END \
+    state.SetItemsProcessed(state.iterations() * keys.size()); \
+    for (auto &k : keys) bft_free(&k);
+
+static void
+ARTFIND_hash (benchmark::State& state)
+{
+    ART_INIT
+    std::unordered_map<string_view, size_t> map;
+    for (size_t i = 0; i < keys.size(); ++i)
+        map[string_view(bft_data(&keys[i]), bft_len(&keys[i]))] = i;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (auto i : order) 
+            sum += map.find(string_view(bft_data(&keys[i]), bft_len(&keys[i])))->second;
+        benchmark::DoNotOptimize(sum);
+    }
+
+    ART_END
+}
+
+static void
+ARTFIND_sorted (benchmark::State& state)
+{
+    ART_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (auto i : order)
+            sum += std::lower_bound(keys.begin(), keys.end(), keys[i], buflt) - keys.begin();
+        benchmark::DoNotOptimize(sum);
+    }
+
+    ART_END
+}
+
+static void
+ARTFIND_art (benchmark::State& state)
+{
+    ART_INIT
+    BuffetArt art = {0};
+    for (size_t i = 0; i < keys.size(); ++i) 
+        bft_art_insert(&art, &keys[i], (void*)i);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t sum = 0;
+        for (auto i : order) sum += (size_t)bft_art_find(&art, &keys[i]);
+        benchmark::DoNotOptimize(sum);
+    }
+
+    bft_art_free(&art);
+    ART_END
+}
+
+//=============================================================================
+// Workloads : log lines, CSV rows and URL paths, split into records then fields.
+// _c copies parts (util.h), _cpp into std::strings, _buffet views them,
+// _range views them lazily.
+enum {LOG, CSV, URL};
+
+static const char *FSEPS[] = {" ", ",", "/"}; // field separators
+
+// deterministic corpus of about `size` bytes
+static string
+corpus (int kind, size_t size)
+{
+    static const char *levels[] = {"INFO", "WARN", "ERROR", "DEBUG"};
+    static const char *cities[] = {"Paris", "Lyon", "San Francisco", "Oslo"};
+    static const char *words[] = {"api", "v1", "users", "orders", "static", 
+        "img", "search", "items"};
+    char line[256];
+    unsigned seed = 7;
+    string ret;
+    ret.reserve(size+sizeof(line));
+
+    while (ret.size() < size) {
+        seed = seed*1103515245 + 12345;
+        unsigned r = seed >> 8;
+        switch (kind) {
+        case LOG:
+            snprintf(line, sizeof(line), 
+                "2024-05-01T12:%02u:%02uZ %s GET /api/v1/users/%u %u %ums\n",
+                r%60, (r>>6)%60, levels[r%4], r%100000, 200+(r%3)*100, r%900);
+            break;
+        case CSV:
+            snprintf(line, sizeof(line), "%u,user%u,%u.%02u,%s,%s\n",
+                r%1000000, r%5000, r%1000, r%100, r%2 ? "true" : "false", 
+                cities[(r>>4)%4]);
+            break;
+        default: {
+            int n = snprintf(line, sizeof(line), "/%s", words[r%8]);
+            for (unsigned d = 0; d < 1+(r>>3)%5; ++d)
+                n += snprintf(line+n, sizeof(line)-n, "/%s", words[(r>>(3*d+6))%8]);
+            snprintf(line+n, sizeof(line)-n, "/%u\n", r%10000);
+        }
+        }
+        ret += line;
+    }
+    ret.pop_back(); // no trailing empty record
+    return ret;
+}
+
+#define WORKLOAD_INIT \
+    const string src = corpus(kind, 1<<20); \
+    const char *fsep = FSEPS[kind];
+
+#define WORKLOAD_END \
+    benchmark::DoNotOptimize(total); \
+    state.SetBytesProcessed(state.iterations() * src.size());
+
+static void 
+WORKLOAD_c (benchmark::State& state, int kind) 
+{
+    WORKLOAD_INIT
+    size_t total = 0;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt;
+        char **recs = split(src.c_str(), "\n", &cnt);
+        for (int i = 0; i < cnt; ++i) {
+            int fcnt;
+            char **fields = split(recs[i], fsep, &fcnt);
+            for (int f = 0; f < fcnt; ++f) {
+                total += strlen(fields[f]);
+                free(fields[f]);
+            }
+            free(fields);
+            free(recs[i]);
+        }
+        free(recs);
+    }
+
+    WORKLOAD_END
+}
+
+static void 
+WORKLOAD_cpp (benchmark::State& state, int kind) 
+{
+    WORKLOAD_INIT
+    size_t total = 0;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (auto &rec : split_string(src, '\n'))
+            for (auto &field : split_string(rec, fsep[0]))
+                total += field.size();
+    }
+
+    WORKLOAD_END
+}
+
+static void 
+WORKLOAD_buffet (benchmark::State& state, int kind) 
+{
+    WORKLOAD_INIT
+    size_t total = 0;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt;
+        Buffet *recs = bft_split(src.data(), src.size(), "\n", 1, &cnt);
+        for (int i = 0; i < cnt; ++i) {
+            int fcnt;
+            Buffet *fields = bft_split(bft_data(&recs[i]), bft_len(&recs[i]), 
+                fsep, 1, &fcnt);
+            for (int f = 0; f < fcnt; ++f) total += bft_len(&fields[f]);
+            bft_freelist(fields, fcnt);
+        }
+        bft_freelist(recs, cnt);
+    }
+
+    WORKLOAD_END
+}
+
+static void 
+WORKLOAD_range (benchmark::State& state, int kind) 
+{
+    WORKLOAD_INIT
+    size_t total = 0;
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (auto rec : bft::split_view(src, "\n"))
+            for (auto field : bft::split_view(rec, fsep))
+                total += field.size();
+    }
+
+    WORKLOAD_END
+}
+
+//=============================================================================
+// KEYS in raw C and sds-style : one allocation per key.
+static void 
+KEYS_c (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<char*> keys(lens.size());
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < lens.size(); ++i) {
+            keys[i] = (char*)malloc(lens[i]+1);
+            memcpy(keys[i], alpha+i%64, lens[i]);
+            keys[i][lens[i]] = 0;
+        }
+        benchmark::DoNotOptimize(keys.data());
+        for (auto k : keys) free(k);
+    }
+
+    state.counters["handle"] = sizeof(char*);
+}
+
+static void 
+KEYS_sds (benchmark::State& state) 
+{
+    const auto lens = keylens(state.range(0));
+    vector<char*> keys(lens.size());
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < lens.size(); ++i) 
+            keys[i] = sds_newlen(alpha+i%64, lens[i]);
+        benchmark::DoNotOptimize(keys.data());
+        for (auto k : keys) sds_free(k);
+    }
+
+    state.counters["handle"] = sizeof(char*);
+}
+
+//=============================================================================
+// Build a buffer of `state.range(0)` bytes by appends of 1 to 16 bytes.
+#define APPENDLOOP_INIT \
+    const size_t total = state.range(0); \
+    assert (total+16 <= alphalen);
+
+#define APPENDLOOP_END \
+    state.SetBytesProcessed(state.iterations() * total);
+
+// piece `i` appended at `pos`
+#define PIECE(pos, i) (alpha+(pos)), (1 + (i)%16)
+
+static void 
+APPENDLOOP_c (benchmark::State& state) 
+{
+    APPENDLOOP_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t len = 0, cap = 16;
+        char *buf = (char*)malloc(cap);
+        for (size_t i = 0; len < total; ++i) {
+            const size_t n = 1 + i%16;
+            if (len+n+1 > cap) {
+                cap = 2*(len+n+1);
+                buf = (char*)realloc(buf, cap);
+            }
+            memcpy(buf+len, alpha+len, n);
+            len += n;
+            buf[len] = 0;
+        }
+        benchmark::DoNotOptimize(buf);
+        free(buf);
+    }
+
+    APPENDLOOP_END
+}
+
+static void 
+APPENDLOOP_cpp (benchmark::State& state) 
+{
+    APPENDLOOP_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        string buf;
+        for (size_t i = 0; buf.size() < total; ++i) 
+            buf.append(PIECE(buf.size(), i));
+        benchmark::DoNotOptimize(buf.data());
+    }
+
+    APPENDLOOP_END
+}
+
+static void 
+APPENDLOOP_sds (benchmark::State& state) 
+{
+    APPENDLOOP_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        char *buf = sds_newlen("", 0);
+        for (size_t i = 0; sds_len(buf) < total; ++i) {
+            char *grown = sds_catlen(buf, PIECE(sds_len(buf), i));
+            if (!grown) {
+                state.SkipWithError("sds_catlen");
+                break;
+            }
+            buf = grown;
+        }
+        benchmark::DoNotOptimize(buf);
+        sds_free(buf);
+    }
+
+    APPENDLOOP_END
+}
+
+static void 
+APPENDLOOP_buffet (benchmark::State& state) 
+{
+    APPENDLOOP_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        Buffet buf = bft_new(0);
+        for (size_t i = 0; bft_len(&buf) < total; ++i) 
+            bft_append(&buf, PIECE(bft_len(&buf), i));
+        benchmark::DoNotOptimize(buf);
+        bft_free(&buf);
+    }
+
+    APPENDLOOP_END
+}
+
+// Same on a monotonic resource, where realloc is alloc+copy.
+static void 
+APPENDLOOP_pmr_cpp (benchmark::State& state) 
+{
+    APPENDLOOP_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena;
+        {
+            std::pmr::string buf(&arena);
+            for (size_t i = 0; buf.size() < total; ++i) 
+                buf.append(PIECE(buf.size(), i));
+            benchmark::DoNotOptimize(buf.data());
+        }
+    }
+
+    APPENDLOOP_END
+}
+
+static void 
+APPENDLOOP_pmr_buffet (benchmark::State& state) 
+{
+    APPENDLOOP_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena;
+        bft::PmrAllocator bftmem(&arena);
+        bft::AllocatorScope scope(bftmem);
+        {
+            Buffet buf = bft_new(0);
+            for (size_t i = 0; bft_len(&buf) < total; ++i) 
+                bft_append(&buf, PIECE(bft_len(&buf), i));
+            benchmark::DoNotOptimize(buf);
+            bft_free(&buf);
+        }
+    }
+
+    APPENDLOOP_END
+}
+
+#undef PIECE
+
+//=============================================================================
+// Churn : a ring of 64 live substrings of a 4KB source, 
+// each step dropping the oldest and taking a new one.
+#define CHURN_RING 64
+#define CHURN_STEPS 1024
+#define CHURN_SRC 4096
+
+// substring of step `i`, 8 to 207 bytes
+#define CHURN_OFF(i) (((i)*37) % (CHURN_SRC-208))
+#define CHURN_LEN(i) (8 + (i)%200)
+
+#define CHURN_END \
+    state.SetItemsProcessed(state.iterations() * CHURN_STEPS);
+
+static void 
+CHURN_c (benchmark::State& state) 
+{
+    char *ring[CHURN_RING] = {0};
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < CHURN_STEPS; ++i) {
+            char **slot = &ring[i%CHURN_RING];
+            free(*slot);
+            *slot = (char*)malloc(CHURN_LEN(i)+1);
+            memcpy(*slot, alpha+CHURN_OFF(i), CHURN_LEN(i));
+            (*slot)[CHURN_LEN(i)] = 0;
+        }
+        benchmark::DoNotOptimize(ring);
+    }
+
+    for (auto s : ring) free(s);
+    CHURN_END
+}
+
+static void 
+CHURN_cpp (benchmark::State& state) 
+{
+    const string src(alpha, CHURN_SRC);
+    string ring[CHURN_RING];
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < CHURN_STEPS; ++i) 
+            ring[i%CHURN_RING] = src.substr(CHURN_OFF(i), CHURN_LEN(i));
+        benchmark::DoNotOptimize(ring);
+    }
+
+    CHURN_END
+}
+
+static void 
+CHURN_sds (benchmark::State& state) 
+{
+    char *ring[CHURN_RING] = {0};
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < CHURN_STEPS; ++i) {
+            char **slot = &ring[i%CHURN_RING];
+            sds_free(*slot);
+            *slot = sds_newlen(alpha+CHURN_OFF(i), CHURN_LEN(i));
+        }
+        benchmark::DoNotOptimize(ring);
+    }
+
+    for (auto s : ring) sds_free(s);
+    CHURN_END
+}
+
+static void 
+CHURN_buffet (benchmark::State& state) 
+{
+    Buffet src = bft_memcopy(alpha, CHURN_SRC);
+    Buffet ring[CHURN_RING] = {};
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        for (size_t i = 0; i < CHURN_STEPS; ++i) {
+            Buffet *slot = &ring[i%CHURN_RING];
+            bft_free(slot);
+            *slot = bft_view(&src, CHURN_OFF(i), CHURN_LEN(i));
+        }
+        benchmark::DoNotOptimize(ring);
+    }
+
+    for (auto &b : ring) bft_free(&b);
+    bft_free(&src);
+    CHURN_END
+}
+
+//=============================================================================
+// Split a large log file into lines.
+static const string&
+bigfile () {
+    static const string ret = corpus(LOG, 1<<24);
+    return ret;
+}
+
+#define BIGSPLIT_END \
+    state.SetBytesProcessed(state.iterations() * src.size());
+
+static void 
+BIGSPLIT_c (benchmark::State& state) 
+{
+    const string &src = bigfile();
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt;
+        char **lines = splitlen(src.c_str(), src.size(), "\n", 1, &cnt);
+        benchmark::DoNotOptimize(lines);
+        for (int i = 0; i < cnt; ++i) free(lines[i]);
+        free(lines);
+    }
+
+    BIGSPLIT_END
+}
+
+static void 
+BIGSPLIT_cpp (benchmark::State& state) 
+{
+    const string &src = bigfile();
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        auto lines = split_cppview(src.c_str(), "\n");
+        benchmark::DoNotOptimize(lines.data());
+    }
+
+    BIGSPLIT_END
+}
+
+static void 
+BIGSPLIT_buffet (benchmark::State& state) 
+{
+    const string &src = bigfile();
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt;
+        Buffet *lines = bft_split(src.data(), src.size(), "\n", 1, &cnt);
+        benchmark::DoNotOptimize(lines);
+        bft_freelist(lines, cnt);
+    }
+
+    BIGSPLIT_END
+}
+
+static void 
+BIGSPLIT_range (benchmark::State& state) 
+{
+    const string &src = bigfile();
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t cnt = 0;
+        for (auto line : bft::split_view(src, "\n")) cnt += !line.empty();
+        benchmark::DoNotOptimize(cnt);
+    }
+
+    BIGSPLIT_END
+}
+
+//=============================================================================
+// Adversarial splits, inputs by adversary() in util.h. Complexity is fitted
+// on the lengths : the cpp reference (string_view::find) is expected at N^2, 
+// buffet at N.
+#define ADVERSARIAL_INIT \
+    const size_t len = state.range(0); \
+    string src(len, 0), sep(len, 0); \
+    size_t seplen; \
+    adversary(kind, src.data(), len, sep.data(), &seplen); \
+    sep.resize(seplen);
+
+#define ADVERSARIAL_END \
+    state.SetComplexityN(src.size()); \
+    state.SetBytesProcessed(state.iterations() * src.size());
+
+static void 
+ADVERSARIAL_cpp (benchmark::State& state, int kind) 
+{
+    ADVERSARIAL_INIT
+    const string_view view(src);
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        vector<string_view> parts;
+        size_t beg = 0;
+        for (size_t end; (end = view.find(sep, beg)) != string_view::npos;) {
+            parts.push_back(view.substr(beg, end-beg));
+            beg = end + sep.size();
+        }
+        parts.push_back(view.substr(beg));
+        benchmark::DoNotOptimize(parts.data());
+    }
+
+    ADVERSARIAL_END
+}
+
+static void 
+ADVERSARIAL_buffet (benchmark::State& state, int kind) 
+{
+    ADVERSARIAL_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        int cnt;
+        Buffet *parts = bft_split(src.data(), src.size(), sep.data(), sep.size(), &cnt);
+        benchmark::DoNotOptimize(parts);
+        bft_freelist(parts, cnt);
+    }
+
+    ADVERSARIAL_END
+}
+
+static void 
+ADVERSARIAL_range (benchmark::State& state, int kind) 
+{
+    ADVERSARIAL_INIT
+
+    COUNT_ALLOCS
+    for (auto _ : state) {
+        size_t cnt = 0;
+        for (auto part : bft::split_view(src, sep)) cnt += part.size();
+        benchmark::DoNotOptimize(cnt);
+    }
+
+    ADVERSARIAL_END
+}
+
+//=====================================================================
+#define MEMCOPY(one, two) \
+BENCHMARK(one)->Arg(8); \
+BENCHMARK(two)->Arg(8); \
+BENCHMARK(one)->Arg(32); \
+BENCHMARK(two)->Arg(32); \
+BENCHMARK(one)->Arg(128); \
+BENCHMARK(two)->Arg(128); \
+BENCHMARK(one)->Arg(512); \
+BENCHMARK(two)->Arg(512); \
+BENCHMARK(one)->Arg(2048); \
+BENCHMARK(two)->Arg(2048); \
+BENCHMARK(one)->Arg(8192); \
+BENCHMARK(two)->Arg(8192); \
+
+#define MEMVIEW(one, two) \
+BENCHMARK(one)->Arg(8); \
+BENCHMARK(two)->Arg(8); \
+
+#define APPEND(one, two) \
+BENCHMARK(one)->Args({8,4});\
+BENCHMARK(two)->Args({8,4});\
+BENCHMARK(one)->Args({8,16});\
+BENCHMARK(two)->Args({8,16});\
+BENCHMARK(one)->Args({24,4});\
+BENCHMARK(two)->Args({24,4});\
+BENCHMARK(one)->Args({24,32});\
+BENCHMARK(two)->Args({24,32});\
+
+MEMVIEW (MEMVIEW_cpp, MEMVIEW_buffet);
+MEMCOPY (MEMCOPY_c, MEMCOPY_buffet);
+APPEND (APPEND_cpp, APPEND_buffet);
+BENCHMARK(COPY_cpp)->Arg(8)->Arg(64)->Arg(4096)->Arg(1<<19);
+BENCHMARK(COPY_buffet)->Arg(8)->Arg(64)->Arg(4096)->Arg(1<<19);
+BENCHMARK(EDIT_cpp)->Arg(16)->Arg(64)->Arg(1024);
+BENCHMARK(EDIT_buffet)->Arg(16)->Arg(64)->Arg(1024);
+BENCHMARK(ACCESS_call);
+BENCHMARK(ACCESS_inline);
+BENCHMARK(DUPFREE_call);
+BENCHMARK(DUPFREE_inline);
+BENCHMARK(PMR_string)->Arg(8)->Arg(32)->Arg(100);
+BENCHMARK(PMR_buffet)->Arg(8)->Arg(32)->Arg(100);
+#define KEYS(one, two) \
+BENCHMARK(one)->Arg(1<<10); \
+BENCHMARK(two)->Arg(1<<10); \
+BENCHMARK(one)->Arg(1<<16); \
+BENCHMARK(two)->Arg(1<<16); \
+BENCHMARK(one)->Arg(1<<20); \
+BENCHMARK(two)->Arg(1<<20); \
+
+#define FOOTPRINT(one, two) \
+BENCHMARK(one)->Arg(15); \
+BENCHMARK(two)->Arg(15); \
+BENCHMARK(one)->Arg(21); \
+BENCHMARK(two)->Arg(21); \
+BENCHMARK(one)->Arg(32); \
+BENCHMARK(two)->Arg(32); \
+
+KEYS (KEYS_cpp, KEYS_buffet);
+KEYS (KEYSCAN_cpp, KEYSCAN_buffet);
+BENCHMARK(KEYSCAN_wrapper)->Arg(1<<10)->Arg(1<<16)->Arg(1<<20);
+FOOTPRINT (FOOTPRINT_buffet, FOOTPRINT_compact);
+KEYS (LOAD_buffet, LOAD_buffet_many);
+KEYS (COLSCAN_buffets, COLSCAN_column);
+KEYS (COLSORT_buffets, COLSORT_column);
+KEYS (COLFIND_buffets, COLFIND_column);
+KEYS (DICTFIND_buffets, DICTFIND_dict);
+BENCHMARK(ARTFIND_hash)->Arg(1<<16)->Arg(1<<20);
+BENCHMARK(ARTFIND_sorted)->Arg(1<<16)->Arg(1<<20);
+BENCHMARK(ARTFIND_art)->Arg(1<<16)->Arg(1<<20);
+BENCHMARK(TOKENS_view)->Arg(8)->Arg(64)->Arg(1024);
+BENCHMARK(TOKENS_views)->Arg(8)->Arg(64)->Arg(1024);
+BENCHMARK(SPLITJOIN_c);
+BENCHMARK(SPLITJOIN_cpp);
+BENCHMARK(SPLITJOIN_buffet);
+BENCHMARK(SPLITSCAN_cppview);
+BENCHMARK(SPLITSCAN_buffet);
+BENCHMARK(SPLITSCAN_range);
+BENCHMARK(SPLITFIRST_cppview);
+BENCHMARK(SPLITFIRST_range);
+BENCHMARK_CAPTURE(SPLITISA, scalar, "scalar")->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+BENCHMARK_CAPTURE(SPLITISA, sse2, "sse2")->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+BENCHMARK_CAPTURE(SPLITISA, avx2, "avx2")->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+#define WORKLOAD(impl) \
+BENCHMARK_CAPTURE(impl, log, LOG); \
+BENCHMARK_CAPTURE(impl, csv, CSV); \
+BENCHMARK_CAPTURE(impl, url, URL); \
+
+WORKLOAD (WORKLOAD_c);
+WORKLOAD (WORKLOAD_cpp);
+WORKLOAD (WORKLOAD_buffet);
+WORKLOAD (WORKLOAD_range);
+KEYS (KEYS_c, KEYS_sds);
+#define APPENDLOOP(impl) \
+BENCHMARK(impl)->Arg(1<<10)->Arg(1<<14)->Arg(1<<19);
+APPENDLOOP (APPENDLOOP_c);
+APPENDLOOP (APPENDLOOP_cpp);
+APPENDLOOP (APPENDLOOP_sds);
+APPENDLOOP (APPENDLOOP_buffet);
+APPENDLOOP (APPENDLOOP_pmr_cpp);
+APPENDLOOP (APPENDLOOP_pmr_buffet);
+BENCHMARK(CHURN_c);
+BENCHMARK(CHURN_cpp);
+BENCHMARK(CHURN_sds);
+BENCHMARK(CHURN_buffet);
+BENCHMARK(BIGSPLIT_c)->Unit(benchmark::kMillisecond);
+BENCHMARK(BIGSPLIT_cpp)->Unit(benchmark::kMillisecond);
+BENCHMARK(BIGSPLIT_buffet)->Unit(benchmark::kMillisecond);
+BENCHMARK(BIGSPLIT_range)->Unit(benchmark::kMillisecond);
+#define ADVERSARIAL(impl) \
+BENCHMARK_CAPTURE(impl, partial, PARTIAL)->RangeMultiplier(4)->Range(1<<12, 1<<20)->Complexity(); \
+BENCHMARK_CAPTURE(impl, prefix, PREFIX)->RangeMultiplier(4)->Range(1<<12, 1<<20)->Complexity(); \
+BENCHMARK_CAPTURE(impl, periodic, PERIODIC)->RangeMultiplier(4)->Range(1<<12, 1<<20)->Complexity(); \
+BENCHMARK_CAPTURE(impl, hugesep, HUGESEP)->RangeMultiplier(4)->Range(1<<12, 1<<20)->Complexity(); \
+BENCHMARK_CAPTURE(impl, empties, EMPTIES)->RangeMultiplier(4)->Range(1<<12, 1<<20)->Complexity(); \
+
+ADVERSARIAL (ADVERSARIAL_cpp);
+ADVERSARIAL (ADVERSARIAL_buffet);
+ADVERSARIAL (ADVERSARIAL_range);
 
 int main(int argc, char** argv)
 {
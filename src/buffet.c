@@ -3,9 +3,12 @@ Buffet - All-inclusive Buffer for C
 Copyright (C) 2022 - Francois Alcover <francois|at|alcover|dot|fr>
 */
 
+#define _GNU_SOURCE // memmem
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#define BUFFET_NO_INLINE // defines the functions themselves
 #include "buffet.h"
 #include "log.h"
 
@@ -15,6 +18,7 @@ typedef enum {SSO=0, OWN, SSV, VUE} Tag;
 typedef struct {
     size_t   cap;       // capacity
     size_t   len;       // current length (for append in place)
+    const BuffetAllocator *mem; // allocator of this store
     uint32_t refcnt;    // number of co-owners
     volatile
     uint32_t canary;    // prevents accessing stale store
@@ -23,15 +27,183 @@ typedef struct {
 
 #define CANARY 0xbeacface   
 #define OVERALLOC 2  // growth factor
+#define SHARE_RATIO 0.5  // store utilization from which a copy is shared
 #define SSO_MAXREF 255 // maximum number of views on an SSO
 #define ZERO BUFFET_ZERO // neutralized empty Buffet
 #define DATAOFF offsetof(Store,data)
 #define TAG(buf) ((buf)->sso.tag)
 #define STOREMEM(cap) (DATAOFF+(cap)+1) // alloc for store of capacity `cap`
 
+// Store refcount. Atomic if built with `BUFFET_THREADSAFE`,
+// so that threads can share, view and free a store.
+#if BUFFET_THREADSAFE
+#define REF_ADD(store, n) __atomic_add_fetch(&(store)->refcnt, (n), __ATOMIC_RELAXED)
+#define REF_SUB(store, n) __atomic_sub_fetch(&(store)->refcnt, (n), __ATOMIC_ACQ_REL)
+#define REF_GET(store)    __atomic_load_n(&(store)->refcnt, __ATOMIC_ACQUIRE)
+#else
+#define REF_ADD(store, n) ((store)->refcnt += (n))
+#define REF_SUB(store, n) ((store)->refcnt -= (n))
+#define REF_GET(store)    ((store)->refcnt)
+#endif
+
 #define ERR_ALLOC ERR("Failed allocation\n")
 #define WARN_CANARY WARN("bad canary, double free ?\n")
 
+//============================================================================
+// Allocator
+//============================================================================
+
+static void* 
+sys_alloc (size_t size, void *ctx) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void* 
+sys_realloc (void *ptr, size_t oldsize, size_t newsize, void *ctx) {
+    (void)oldsize; (void)ctx;
+    return realloc(ptr, newsize);
+}
+
+static void
+sys_free (void *ptr, size_t size, void *ctx) {
+    (void)size; (void)ctx;
+    free(ptr);
+}
+
+static const BuffetAllocator sys_allocator = {
+    .alloc = sys_alloc,
+    .realloc = sys_realloc,
+    .free = sys_free,
+    .ctx = NULL
+};
+
+static const BuffetAllocator *global_allocator = &sys_allocator;
+static _Thread_local const BuffetAllocator *thread_allocator = NULL;
+
+// allocator in effect for the calling thread
+static inline const BuffetAllocator*
+getmem (void) {
+    const BuffetAllocator *mem = thread_allocator;
+    return mem ? mem : global_allocator;
+}
+
+#define MEM_ALLOC(mem, size) ((mem)->alloc((size), (mem)->ctx))
+#define MEM_REALLOC(mem, ptr, oldsize, newsize) \
+    ((mem)->realloc((ptr), (oldsize), (newsize), (mem)->ctx))
+#define MEM_FREE(mem, ptr, size) ((mem)->free((ptr), (size), (mem)->ctx))
+
+//============================================================================
+// Statistics
+//============================================================================
+
+#if BUFFET_STATS
+
+#include <pthread.h>
+
+// Counters are per-thread, so counting is a plain relaxed store.
+// Slots are chained for aggregation by bft_stats_get().
+// On thread exit, a slot is folded into `stats_retired`.
+typedef struct StatsSlot {
+    BuffetStats cnt;
+    struct StatsSlot *prev;
+    struct StatsSlot *next;
+} StatsSlot;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static StatsSlot *stats_slots = NULL;
+static BuffetStats stats_retired = {0};
+static _Thread_local StatsSlot *stats_local = NULL;
+
+#define STATS_FIELDS(X) \
+    X(stores_new) X(stores_freed) X(bytes_live) X(reallocs) \
+    X(appends_inplace) X(detaches) X(sso_promotions) X(ssv_saturations) \
+    X(copies_shared) X(sso_demotions) X(search_bytes)
+
+// sum fields (bytes_live may wrap per-thread, the total is exact)
+static void
+stats_add (BuffetStats *dst, const BuffetStats *src)
+{
+    #define ADD(f) dst->f += __atomic_load_n(&src->f, __ATOMIC_RELAXED);
+    STATS_FIELDS(ADD)
+    #undef ADD
+}
+
+static void
+stats_retire (void *arg)
+{
+    StatsSlot *slot = arg;
+
+    pthread_mutex_lock(&stats_lock);
+    stats_add(&stats_retired, &slot->cnt);
+    if (slot->prev) slot->prev->next = slot->next;
+    else stats_slots = slot->next;
+    if (slot->next) slot->next->prev = slot->prev;
+    pthread_mutex_unlock(&stats_lock);
+
+    free(slot);
+    // runs on the dying thread : a later count (e.g. from another TLS 
+    // destructor) registers a new slot, retired on the next round
+    stats_local = NULL;
+}
+
+static void
+stats_init (void) {
+    pthread_key_create(&stats_key, stats_retire);
+}
+
+static StatsSlot*
+stats_register (void)
+{
+    StatsSlot *slot = calloc(1, sizeof(StatsSlot));
+    if (!slot) {ERR_ALLOC; abort();}
+
+    pthread_once(&stats_once, stats_init);
+    pthread_setspecific(stats_key, slot);
+
+    pthread_mutex_lock(&stats_lock);
+    slot->next = stats_slots;
+    if (stats_slots) stats_slots->prev = slot;
+    stats_slots = slot;
+    pthread_mutex_unlock(&stats_lock);
+
+    stats_local = slot;
+    return slot;
+}
+
+static inline BuffetStats*
+stats_get_local (void) {
+    StatsSlot *slot = stats_local;
+    if (!slot) slot = stats_register();
+    return &slot->cnt;
+}
+
+#define STAT(field, n) do { \
+    BuffetStats *_st = stats_get_local(); \
+    __atomic_store_n(&_st->field, _st->field + (n), __ATOMIC_RELAXED); \
+} while(0)
+
+#else
+#define STAT(field, n) ((void)(n))
+#endif
+
+//============================================================================
+// Tracing
+//============================================================================
+
+// USDT probes, enabled by building with `BUFFET_TRACE` (requires sys/sdt.h).
+// Each probe carries a size and the return address of the calling site.
+// Ex: bpftrace -e 'usdt:./app:buffet:store_new { @[arg0] = count(); }'
+#if BUFFET_TRACE
+#include <sys/sdt.h>
+#define TRACE(probe, size) \
+    STAP_PROBE2(buffet, probe, (size_t)(size), __builtin_return_address(0))
+#else
+#define TRACE(probe, size) ((void)0)
+#endif
+
 static inline char*
 getdata (const Buffet *buf, Tag tag) {
     return tag==SSO ? (char*)buf->sso.data : buf->ptr.data;
@@ -50,12 +222,18 @@ getstore (const Buffet *buf) {
 static inline Store*
 new_store (size_t cap, size_t len)
 {
-    Store *store = malloc(STOREMEM(cap));
+    const BuffetAllocator *mem = getmem();
+    Store *store = MEM_ALLOC(mem, STOREMEM(cap));
     if (!store) {ERR_ALLOC; return NULL;}
 
+    STAT(stores_new, 1);
+    STAT(bytes_live, STOREMEM(cap));
+    TRACE(store_new, cap);
+
     *store = (Store){
         .cap = cap,
         .len = len,
+        .mem = mem,
         .refcnt = 1, 
         .canary = CANARY,
     };
@@ -63,6 +241,20 @@ new_store (size_t cap, size_t len)
     return store;
 }
 
+// drop a co-owner, release the store if it was the last
+static inline void
+unref_store (Store *store)
+{
+    if (!REF_SUB(store, 1)) {
+        store->canary = 0;
+        LOG("free store");
+        STAT(stores_freed, 1);
+        STAT(bytes_live, -STOREMEM(store->cap));
+        TRACE(store_free, store->cap);
+        MEM_FREE(store->mem, store, STOREMEM(store->cap));
+    }
+}
+
 static inline Buffet
 new_vue (const char *src, size_t len)
 {
@@ -79,6 +271,7 @@ new_ssovue (Buffet *src, size_t len, size_t off)
 {
     if (src->sso.rfc >= SSO_MAXREF) {
         ERR("reached max views on SSO.\n");
+        STAT(ssv_saturations, 1);
         return ZERO;
     }
 
@@ -96,7 +289,7 @@ static void
 dbgstore (const Store *store) 
 {
     printf("cap:%zu refcnt:%d data:\"%.*s\"\n", 
-        store->cap, store->refcnt, (int)(store->len +1), store->data);
+        store->cap, REF_GET(store), (int)(store->len +1), store->data);
     fflush(stdout);
 }
 
@@ -120,6 +313,150 @@ dbg (const Buffet* buf)
     if (tag==OWN) dbgstore(getstore(buf));
 }
 
+//============================================================================
+// CPU dispatch
+//============================================================================
+
+// Vector kernels are picked once at startup from the CPU features, 
+// or from the `BUFFET_FORCE_ISA` environment variable (scalar|sse2|avx2).
+// Each tier has a scalar fallback, and only the best tier <= the selected 
+// one is used by a kernel.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ISA_X86 1
+#include <immintrin.h>
+#endif
+
+typedef enum {ISA_SCALAR=0, ISA_SSE2, ISA_AVX2, ISA_COUNT} Isa;
+
+static const char *isa_names[ISA_COUNT] = {"scalar", "sse2", "avx2"};
+
+typedef const char* (*FindFn) (const char *src, size_t srclen, 
+    const char *sep, size_t seplen);
+
+// memmem is linear (two-way in glibc and musl) : counted as the span it covers
+static const char*
+find_scalar (const char *src, size_t srclen, const char *sep, size_t seplen) 
+{
+    const char *ret = memmem(src, srclen, sep, seplen);
+    STAT(search_bytes, ret ? (size_t)(ret-src) + seplen : srclen);
+    return ret;
+}
+
+#if ISA_X86
+
+// Candidates are positions where both the first and last bytes of `sep`
+// match, verified by memcmp. Repeated false candidates (e.g. periodic input)
+// hand over to memmem, keeping the search linear.
+#define FIND_VECTOR(name, isa, vec, width, set1, loadu, cmpeq, vand, movemask) \
+__attribute__((target(isa))) \
+static const char* \
+name (const char *src, size_t srclen, const char *sep, size_t seplen) \
+{ \
+    if (seplen < 2 || srclen < seplen+width) \
+        return find_scalar(src, srclen, sep, seplen); \
+    const vec first = set1(sep[0]); \
+    const vec last = set1(sep[seplen-1]); \
+    const size_t end = srclen-seplen+1; \
+    size_t work = 0; \
+    size_t i = 0; \
+    for (; i+width <= end; i += width) { \
+        const vec a = loadu((const vec*)(src+i)); \
+        const vec b = loadu((const vec*)(src+i+seplen-1)); \
+        unsigned mask = movemask(vand(cmpeq(a, first), cmpeq(b, last))); \
+        while (mask) { \
+            const size_t pos = i + __builtin_ctz(mask); \
+            if (!memcmp(src+pos+1, sep+1, seplen-2)) { \
+                STAT(search_bytes, i + width + work + seplen); \
+                return src+pos; \
+            } \
+            if ((work += seplen) > 2*pos + 256) { \
+                STAT(search_bytes, i + width + work); \
+                return find_scalar(src+pos, srclen-pos, sep, seplen); \
+            } \
+            mask &= mask-1; \
+        } \
+    } \
+    STAT(search_bytes, i + work); \
+    return find_scalar(src+i, srclen-i, sep, seplen); \
+}
+
+FIND_VECTOR(find_sse2, "sse2", __m128i, 16, _mm_set1_epi8, _mm_loadu_si128,
+    _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8)
+FIND_VECTOR(find_avx2, "avx2", __m256i, 32, _mm256_set1_epi8, _mm256_loadu_si256,
+    _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_movemask_epi8)
+
+#undef FIND_VECTOR
+
+static const FindFn find_fns[ISA_COUNT] = {find_scalar, find_sse2, find_avx2};
+
+static Isa
+isa_detect (void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+    if (__builtin_cpu_supports("sse2")) return ISA_SSE2;
+    return ISA_SCALAR;
+}
+
+#else
+
+static const FindFn find_fns[ISA_COUNT] = {find_scalar, find_scalar, find_scalar};
+
+static Isa
+isa_detect (void) {
+    return ISA_SCALAR;
+}
+
+#endif
+
+static Isa isa_level = ISA_SCALAR;
+static FindFn find_kernel = find_scalar;
+
+/**
+ * Select the vector kernels tier, for the whole process.
+ * Not to be called while other threads use the library.
+ * @param[in] isa "scalar", "sse2" or "avx2", or NULL for the best supported
+ * @return false if `isa` is unknown or not supported by the CPU
+ */
+bool
+bft_set_isa (const char *isa)
+{
+    const Isa best = isa_detect();
+    Isa level = best;
+
+    if (isa) {
+        for (level = 0; level < ISA_COUNT; ++level)
+            if (!strcmp(isa, isa_names[level])) break;
+        if (level == ISA_COUNT || level > best) return false;
+    }
+
+    isa_level = level;
+    find_kernel = find_fns[level];
+    return true;
+}
+
+/**
+ * Get the vector kernels tier in use.
+ * @return "scalar", "sse2" or "avx2"
+ */
+const char*
+bft_isa (void) {
+    return isa_names[isa_level];
+}
+
+__attribute__((constructor))
+static void
+isa_init (void)
+{
+    const char *force = getenv("BUFFET_FORCE_ISA");
+    if (force && !bft_set_isa(force)) {
+        ERR("BUFFET_FORCE_ISA=%s unsupported, using %s\n", force, 
+            isa_names[isa_detect()]);
+        force = NULL;
+    }
+    if (!force) bft_set_isa(NULL);
+}
+
 //============================================================================
 // Public
 //============================================================================
@@ -179,6 +516,72 @@ bft_memcopy (const char *src, size_t len)
     return ret;
 }
 
+/**
+ * Copy many byte ranges into Buffets sharing a single store.
+ * Ranges over BUFFET_SSOMAX are packed, null-terminated, into one exact-size
+ * store and `out` gets OWN views on it. Shorter ones become SSOs.
+ * Ex: loading a dictionary makes one allocation instead of n.
+ *
+ * @param[in] srcs the source addresses
+ * @param[in] lens the source lengths
+ * @param[in] cnt the number of sources
+ * @param[out] out the resulting Buffets array of length `cnt`
+ * @return false on allocation failure, with `out` zeroed
+ */
+bool
+bft_memcopy_many (const char *const *srcs, const size_t *lens, int cnt, 
+    Buffet *out)
+{
+    size_t total = 0;
+    int owncnt = 0;
+
+    for (int i = 0; i < cnt; ++i) {
+        if (lens[i] > BUFFET_SSOMAX) {
+            total += lens[i]+1;
+            ++ owncnt;
+        }
+    }
+
+    Store *store = NULL;
+
+    if (owncnt) {
+        // last terminator is the store's own
+        store = new_store(total-1, total-1);
+        if (!store) {
+            for (int i = 0; i < cnt; ++i) out[i] = ZERO;
+            return false;
+        }
+        store->refcnt = owncnt;
+    }
+
+    size_t off = 0;
+
+    for (int i = 0; i < cnt; ++i) {
+
+        const size_t len = lens[i];
+
+        if (len <= BUFFET_SSOMAX) {
+            out[i] = ZERO;
+            memcpy(out[i].sso.data, srcs[i], len);
+            out[i].sso.len = len;
+            continue;
+        } 
+
+        char *data = store->data + off;
+        memcpy(data, srcs[i], len);
+        data[len] = 0;
+        out[i] = (Buffet) {
+            .ptr.data = data,
+            .ptr.len = len,
+            .ptr.off = off,
+            .ptr.tag = OWN
+        };
+        off += len+1;
+    }
+
+    return true;
+}
+
 /**
  * Create a new Buffet viewing a range of bytes
  * @param[in] src the source address
@@ -189,8 +592,39 @@ bft_memview (const char *src, size_t len) {
     return new_vue(src, len);
 }
 
+// Copy on write : an OWN range too long for SSO shares the source store,
+// if it fills enough of it that bft_compact() would keep it there.
+// A small range is copied, so it does not pin a big store.
+// Mutators (bft_append...) detach it from co-owners before writing.
+static Buffet
+copy_range (const Buffet *src, Tag tag, size_t off, size_t len)
+{
+    if (tag == OWN && len > BUFFET_SSOMAX) {
+        Store *store = getstore(src);
+        #if MEMCHECK
+            if (store->canary != CANARY) {WARN_CANARY; return ZERO;}
+        #endif
+        if (len < SHARE_RATIO * store->cap) {
+            return bft_memcopy(src->ptr.data + off, len);
+        }
+        REF_ADD(store, 1);
+        STAT(copies_shared, 1);
+
+        return (Buffet) {
+            .ptr.data = src->ptr.data + off,
+            .ptr.len = len,
+            .ptr.off = src->ptr.off + off,
+            .ptr.tag = OWN
+        };
+    }
+
+    return bft_memcopy(getdata(src,tag)+off, len);
+}
+
 /**
- * Create a new Buffet copying a Buffet's data
+ * Create a new Buffet copying a Buffet's data.
+ * An OWN range over SSO size filling at least half its store is not copied
+ * until either side is mutated.
  * @param[in] src the source Buffet
  * @param[in] off offset to start from
  * @param[in] len length in bytes
@@ -203,20 +637,21 @@ bft_copy (const Buffet *src, size_t off, size_t len)
     if (off+len > getlen(src,tag)) {
         return ZERO;
     } else {
-        return bft_memcopy(getdata(src,tag)+off, len);
+        return copy_range(src, tag, off, len);
     }
 }
 
 /**
- * Create a new Buffet copying a Buffet's whole data
+ * Create a new Buffet copying a Buffet's whole data.
+ * An OWN source over SSO size filling at least half its store is not copied
+ * until either side is mutated.
  * @param[in] src the source Buffet
  */
-// todo optim + check
 Buffet
 bft_copyall (const Buffet *src)
 {
     Tag tag = TAG(src);
-    return bft_memcopy(getdata(src,tag), getlen(src,tag));
+    return copy_range(src, tag, 0, getlen(src,tag));
 }
 
 /**
@@ -243,7 +678,7 @@ bft_dup (const Buffet *src)
             #if MEMCHECK
                 if (store->canary != CANARY) {WARN_CANARY; return ZERO;}
             #endif
-            ++ store->refcnt;
+            REF_ADD(store, 1);
             break;
         }
         
@@ -297,7 +732,7 @@ bft_view (Buffet *src, size_t off, size_t len)
                 if (store->canary != CANARY) {WARN_CANARY; return ZERO;}
             #endif
 
-            ++ store->refcnt; 
+            REF_ADD(store, 1); 
 
             return (Buffet) {
                 .ptr.data = src->ptr.data + off,
@@ -311,6 +746,87 @@ bft_view (Buffet *src, size_t off, size_t len)
     return ZERO;
 }
 
+/**
+ * Create many views on a Buffet at once.
+ * Same as calling bft_view for each range, except that `src` is resolved 
+ * and checked once and its refcount is raised once by the views total.
+ * Ex: an owning tokenizer.
+ *
+ * @param[in] src the source Buffet
+ * @param[in] offs the offsets to start from
+ * @param[in] lens the lengths in bytes
+ * @param[in] cnt the number of views
+ * @param[out] out the resulting views array of length `cnt`
+ * @return false if `src` is invalid or an SSO that would exceed max views, 
+ * with `out` zeroed
+ */
+bool
+bft_views (Buffet *src, const size_t *offs, const size_t *lens, int cnt, 
+    Buffet *out)
+{
+    Tag tag = TAG(src);
+    size_t srclen = getlen(src,tag);
+    char *data = getdata(src,tag);
+    size_t srcoff = 0; // offset of `src` in its store or SSO
+    Store *store = NULL;
+    BuffetSSO *target = &src->sso;
+    int refs = 0;
+
+    if (tag==OWN) {
+        store = getstore(src);
+        #if MEMCHECK
+            if (store->canary != CANARY) {
+                WARN_CANARY; 
+                goto fail;
+            }
+        #endif
+        srcoff = src->ptr.off;
+    } else if (tag==SSV) {
+        srcoff = src->ptr.off;
+        target = (BuffetSSO*)(src->ptr.data - srcoff);
+    }
+
+    for (int i = 0; i < cnt; ++i) {
+
+        size_t off = offs[i];
+        size_t len = lens[i];
+
+        if (!len||off>=srclen) {out[i] = ZERO; continue;}
+        // clipping
+        if (off+len > srclen) len = srclen-off;
+
+        if (tag==VUE) {
+            out[i] = new_vue(data+off, len);
+            continue;
+        }
+
+        out[i] = (Buffet) {
+            .ptr.data = data + off,
+            .ptr.len = len,
+            .ptr.off = srcoff + off,
+            .ptr.tag = (tag==OWN) ? OWN : SSV
+        };
+        ++ refs;
+    }
+
+    if (tag==OWN) {
+        if (refs) REF_ADD(store, refs);
+    } else if (tag!=VUE) {
+        if (target->rfc + refs > SSO_MAXREF) {
+            ERR("reached max views on SSO.\n");
+            STAT(ssv_saturations, 1);
+            goto fail;
+        }
+        target->rfc += refs;
+    }
+
+    return true;
+
+    fail:
+    for (int i = 0; i < cnt; ++i) out[i] = ZERO;
+    return false;
+}
+
 /**
  * Discard a Buffet.
  * aborts if buf is an SSO with views
@@ -341,13 +857,7 @@ bft_free (Buffet *buf)
             }
         #endif
 
-        -- store->refcnt;
-
-        if (!store->refcnt) {
-            store->canary = 0;
-            LOG("free store");
-            free(store);
-        }
+        unref_store(store);
 
     } else if (tag==SSV) {
         // check ? No, fault would be user losing scope
@@ -361,6 +871,111 @@ bft_free (Buffet *buf)
 }
 
 
+/**
+ * Get the heap memory a Buffet keeps alive.
+ * For an OWN, this is the whole allocation of its store,
+ * whatever the share actually viewed. Other modes retain nothing.
+ *
+ * @param[in] buf the Buffet source
+ * @return retained bytes
+ */
+size_t
+bft_retained (const Buffet *buf)
+{
+    if (TAG(buf) != OWN) return 0;
+
+    const Store *store = getstore(buf);
+    #if MEMCHECK
+        if (store->canary != CANARY) {WARN_CANARY; return 0;}
+    #endif
+
+    return STOREMEM(store->cap);
+}
+
+
+/**
+ * Detach a small OWN from a large store.
+ * If `buf` uses less than `ratio` of its store capacity, its data is copied
+ * into an SSO or an exact-size store and its share of the old store is
+ * released.
+ * Ex: a 20-bytes view on a 1MB store would not pin the store anymore.
+ *
+ * @param[in,out] buf the Buffet to compact
+ * @param[in] ratio utilization under which `buf` is compacted
+ * @return true if `buf` was compacted
+ */
+bool
+bft_compact (Buffet *buf, double ratio)
+{
+    if (TAG(buf) != OWN) return false;
+
+    const Store *store = getstore(buf);
+    #if MEMCHECK
+        if (store->canary != CANARY) {WARN_CANARY; return false;}
+    #endif
+
+    const size_t len = buf->ptr.len;
+    if (len >= ratio * store->cap) return false;
+
+    Buffet out = bft_memcopy(buf->ptr.data, len);
+    if (len > BUFFET_SSOMAX && TAG(&out) != OWN) return false;
+
+    bft_free(buf);
+    *buf = out;
+
+    return true;
+}
+
+
+/**
+ * Compact a list of Buffets.
+ * @see bft_compact
+ *
+ * @param[in,out] list the Buffet array
+ * @param[in] cnt the array length
+ * @param[in] ratio utilization under which an element is compacted
+ * @return number of compacted elements
+ */
+int
+bft_compact_many (Buffet *list, int cnt, double ratio)
+{
+    int ret = 0;
+
+    for (int i = 0; i < cnt; ++i) {
+        ret += bft_compact(&list[i], ratio);
+    }
+
+    return ret;
+}
+
+
+/**
+ * Turn a short OWN back into an SSO, releasing its share of the store.
+ * The last owner frees the store. Edits like bft_erase() do it on their own
+ * for a unique owner.
+ *
+ * @param[in,out] buf the Buffet to normalize
+ * @return true if `buf` was demoted
+ */
+bool
+bft_normalize (Buffet *buf)
+{
+    if (TAG(buf) != OWN || buf->ptr.len > BUFFET_SSOMAX) return false;
+
+    #if MEMCHECK
+        const Store *store = getstore(buf);
+        if (store->canary != CANARY) {WARN_CANARY; return false;}
+    #endif
+
+    Buffet out = bft_memcopy(buf->ptr.data, buf->ptr.len);
+    STAT(sso_demotions, 1);
+    bft_free(buf);
+    *buf = out;
+
+    return true;
+}
+
+
 /**
  * Concatenates a Buffet and a byte array into a new Buffet.
  * Returns total length, or zero on allocation failure.
@@ -418,10 +1033,8 @@ bft_cat (Buffet *dst, const Buffet *buf, const char *src, size_t srclen)
         writeoff = buf->ptr.off + curlen;
         ssofit = (newlen <= BUFFET_SSOMAX);
 
-        // todo decide if downsized owner (unique) could convert to SSO
-        // if (newlen <= BUFFET_SSOMAX) {}
-
-        if (tag == OWN) {
+        // a short result is an SSO rather than a view pinning the store
+        if (tag == OWN && !ssofit) {
 
             store = getstore(buf);
             #if MEMCHECK
@@ -432,7 +1045,7 @@ bft_cat (Buffet *dst, const Buffet *buf, const char *src, size_t srclen)
                 }
             #endif
 
-            bool alone = store->refcnt < 2;
+            bool alone = REF_GET(store) < 2;
 
             // in-place optimization:
             // if store has room and `buf` is unique owner or at end,
@@ -441,12 +1054,13 @@ bft_cat (Buffet *dst, const Buffet *buf, const char *src, size_t srclen)
                 && (alone || writeoff == store->len)) {
 
                 //LOG("cat OWN: inplace");
+                STAT(appends_inplace, 1);
                 writer = store->data + writeoff;
                 memcpy(writer, src, srclen);
                 writer[srclen] = 0;
                 store->len = writeoff+srclen;
                 *dst = *buf;
-                ++ store->refcnt;
+                REF_ADD(store, 1);
                 dst->ptr.len = newlen;
 
                 return newlen;
@@ -485,6 +1099,8 @@ bft_cat (Buffet *dst, const Buffet *buf, const char *src, size_t srclen)
         return 0;
     }
 
+    if (tag==SSO) STAT(sso_promotions, 1);
+
     // copy data
     writer = store->data;
     memcpy(writer, curdata, curlen);
@@ -567,7 +1183,7 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
                 }
             #endif
 
-            bool alone = store->refcnt < 2;
+            bool alone = REF_GET(store) < 2;
 
             // append in-place: only if store has room
             // and (`buf` is unique owner or at end).
@@ -575,6 +1191,7 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
                 && (alone || writeoff == store->len)) {
 
                 //LOG("append OWN: inplace");
+                STAT(appends_inplace, 1);
                 writer = store->data + writeoff;
                 memcpy(writer, src, srclen);
                 writer[srclen] = 0;
@@ -587,20 +1204,32 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
             } else if (alone) {
                 // optim: shift left if off=0 ?
                 LOG("append OWN: realloc");
+                // geometric, so append loops stay amortized O(n)
+                // even with a copying realloc (e.g. PmrAllocator)
+                size_t oldcap = store->cap;
                 size_t newcap = writeoff + OVERALLOC*srclen;
-                store = realloc(store, STOREMEM(newcap));
+                if (newcap < OVERALLOC*oldcap) newcap = OVERALLOC*oldcap;
+                store = MEM_REALLOC(store->mem, store, 
+                    STOREMEM(oldcap), STOREMEM(newcap));
                 if (!store) {
                     ERR("append realloc\n");
                     return 0;
                 }
+                STAT(reallocs, 1);
+                TRACE(store_realloc, newcap);
+                STAT(bytes_live, STOREMEM(newcap)-STOREMEM(oldcap));
+                store->cap = newcap;
+                store->len = writeoff+srclen;
                 writer = store->data + writeoff;
                 goto appn;
             
             // detach
             } else {
                 LOG("detach");
-                assert(store->refcnt);
-                -- store->refcnt; // check ?
+                STAT(detaches, 1);
+                TRACE(detach, curlen);
+                assert(REF_GET(store));
+                REF_SUB(store, 1); // check ?
                 // todo: way to adjust end*
             }
 
@@ -617,6 +1246,7 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
                 && (alone || writeoff == target->len)) {
 
                 //LOG("append SSV: inplace");
+                STAT(appends_inplace, 1);
                 writer = target->data + writeoff;
                 memcpy(writer, src, srclen);
                 writer[srclen] = 0;
@@ -626,6 +1256,8 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
             }
 
             // detach
+            STAT(detaches, 1);
+            TRACE(detach, curlen);
             -- target->rfc;
         }
     } // end case ptr
@@ -650,6 +1282,8 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
     store = new_store(OVERALLOC*newlen, newlen);
     if (!store) {return 0;}
 
+    if (tag==SSO) STAT(sso_promotions, 1);
+
     writer = store->data;
     memcpy(writer, curdata, curlen);
     writer += curlen;
@@ -659,81 +1293,321 @@ bft_append (Buffet *buf, const char *src, size_t srclen)
 appn:
     memcpy(writer, src, srclen);
     writer[srclen] = 0;
-    buf->ptr.data = store->data;
+    buf->ptr.data = store->data + buf->ptr.off;
     buf->ptr.len = newlen;
 
     return newlen;               
 }
 
 
-
-#define LIST_STACK_MAX (BUFFET_STACK_MEM/sizeof(Buffet))
-
-/**
- * Split a bytes source into a list of Buffets.
- *
- * @param[in] src the bytes source
- * @param[in] srclen the source length in bytes
- * @param[in] sep the separator string
- * @param[in] seplen the separator length in bytes
- * @param[out] outcnt the resulting list length
- * @return the resulting parts Buffet array
-*/
-Buffet*
-bft_split (const char* src, size_t srclen, const char* sep, size_t seplen, 
-    int *outcnt)
+// Replace `dellen` bytes at `off` by `inslen` bytes of `src`.
+// Writes in place if `buf` is an SSO without views or the unique owner of
+// its store. Otherwise (or if `src` overlaps `buf`) detaches into a new one.
+// A unique owner shrunk to SSO size frees its store.
+// Returns new length, or zero on error.
+static size_t
+splice (Buffet *buf, size_t off, size_t dellen, const char *src, size_t inslen)
 {
-    int curcnt = 0; 
-    Buffet *ret = NULL;
-    
-    Buffet parts_local[LIST_STACK_MAX]; 
-    Buffet *parts = parts_local;
-    Buffet *parts_alloc = NULL; // avoid annoying 'ret local var' warning
-    bool local = true;
-    int partsmax = LIST_STACK_MAX;
+    const Tag tag = TAG(buf);
+    char *data = (char*)getdata(buf, tag);
+    const size_t curlen = getlen(buf, tag);
 
-    const char *beg = src;
-    const char *end = beg;
+    if (off > curlen) {
+        WARN("offset out of range\n");
+        return 0;
+    }
 
-    while ((end = strstr(end, sep))) {
+    if (dellen > curlen-off) dellen = curlen-off;
+    if (!dellen && !inslen) return curlen;
 
-        if (curcnt >= partsmax-1) {
+    const size_t newlen = curlen - dellen + inslen;
+    const size_t taillen = curlen - off - dellen;
+    const bool alias = inslen && (src < data+curlen && src+inslen > data);
+    bool shared = (tag == SSV);
 
-            partsmax *= 2;
-            size_t newsz = partsmax * sizeof(Buffet);
+    if (tag == SSO) {
 
-            if (local) {
-                parts = malloc(newsz); 
-                if (!parts) {curcnt = 0; goto fin;}
-                memcpy(parts, parts_local, curcnt * sizeof(Buffet));
-                local = false;
-                parts_alloc = parts;
-            } else {
-                parts = realloc(parts, newsz); 
-                if (!parts) {curcnt = 0; goto fin;}
-            }
+        if (buf->sso.rfc) {
+            WARN("Mutation would invalidate views on SSO\n");
+            return 0;
         }
 
-        parts[curcnt++] = new_vue(beg, end-beg);
-        beg = end+seplen;
-        end = beg;
-    };
-    
-    // last part
-    parts[curcnt++] = new_vue(beg, src+srclen-beg);
+        if (newlen <= BUFFET_SSOMAX && !alias) {
+            memmove(data+off+inslen, data+off+dellen, taillen);
+            if (inslen) memcpy(data+off, src, inslen);
+            data[newlen] = 0;
+            buf->sso.len = newlen;
+            return newlen;
+        }
 
-    if (local) {
-        size_t outlen = curcnt * sizeof(Buffet);
-        ret = malloc(outlen);
-        memcpy(ret, parts, outlen);
-    } else {
-        ret = parts_alloc;  
-    }
+    } else if (tag == OWN) {
 
-    fin:
-    *outcnt = curcnt;
+        Store *store = getstore(buf);
+        #if MEMCHECK
+            if (store->canary != CANARY) {WARN_CANARY; return 0;}
+        #endif
+        shared = REF_GET(store) > 1;
 
-    return ret;
+        // a short unique owner is demoted to SSO below
+        if (!shared && !alias && newlen > BUFFET_SSOMAX) {
+
+            const size_t start = buf->ptr.off;
+
+            if (start+newlen > store->cap) {
+                size_t oldcap = store->cap;
+                size_t newcap = start + OVERALLOC*newlen;
+                store = MEM_REALLOC(store->mem, store,
+                    STOREMEM(oldcap), STOREMEM(newcap));
+                if (!store) {
+                    ERR("splice realloc\n");
+                    return 0;
+                }
+                STAT(reallocs, 1);
+                TRACE(store_realloc, newcap);
+                STAT(bytes_live, STOREMEM(newcap)-STOREMEM(oldcap));
+                store->cap = newcap;
+                data = store->data + start;
+                buf->ptr.data = data;
+            }
+
+            memmove(data+off+inslen, data+off+dellen, taillen);
+            if (inslen) memcpy(data+off, src, inslen);
+            data[newlen] = 0;
+            store->len = start+newlen;
+            buf->ptr.len = newlen;
+            return newlen;
+        }
+    }
+
+    // detach : build the result apart, then release `buf`
+    Buffet out = ZERO;
+    char *writer = out.sso.data;
+
+    if (newlen <= BUFFET_SSOMAX) {
+        out.sso.len = newlen;
+    } else {
+        Store *store = new_store(newlen, newlen);
+        if (!store) return 0;
+        if (tag == SSO) STAT(sso_promotions, 1);
+        writer = store->data;
+        out = (Buffet) {
+            .ptr.data = writer,
+            .ptr.len = newlen,
+            .ptr.off = 0,
+            .ptr.tag = OWN
+        };
+    }
+
+    memcpy(writer, data, off);
+    if (inslen) memcpy(writer+off, src, inslen);
+    memcpy(writer+off+inslen, data+off+dellen, taillen);
+    writer[newlen] = 0;
+
+    if (shared) {
+        STAT(detaches, 1);
+        TRACE(detach, curlen);
+    } else if (tag == OWN && newlen <= BUFFET_SSOMAX) {
+        STAT(sso_demotions, 1);
+    }
+
+    bft_free(buf);
+    *buf = out;
+
+    return newlen;
+}
+
+/**
+ * Insert a byte array into a Buffet.
+ * In place if `buf` is an SSO without views or the unique owner of its store.
+ * A shared or viewing Buffet is detached first. An SSO with views fails.
+ *
+ * @param[in,out] buf the destination Buffet
+ * @param[in] off the insertion offset, up to `buf` length
+ * @param[in] src the byte array source
+ * @param[in] srclen the source length
+ * @return the Buffet new length or zero on error
+*/
+size_t
+bft_insert (Buffet *buf, size_t off, const char *src, size_t srclen) {
+    return splice(buf, off, 0, src, srclen);
+}
+
+/**
+ * Remove a range of bytes from a Buffet, with bft_insert() rules.
+ *
+ * @param[in,out] buf the Buffet
+ * @param[in] off the range offset, up to `buf` length
+ * @param[in] len the range length, clipped to `buf` end
+ * @return the Buffet new length or zero on error
+*/
+size_t
+bft_erase (Buffet *buf, size_t off, size_t len) {
+    return splice(buf, off, len, NULL, 0);
+}
+
+/**
+ * Overwrite bytes of a Buffet, extending it if needed, with bft_insert() rules.
+ *
+ * @param[in,out] buf the destination Buffet
+ * @param[in] off the write offset, up to `buf` length
+ * @param[in] src the byte array source
+ * @param[in] srclen the source length
+ * @return the Buffet new length or zero on error
+*/
+size_t
+bft_overwrite (Buffet *buf, size_t off, const char *src, size_t srclen) {
+    return splice(buf, off, srclen, src, srclen);
+}
+
+/**
+ * Set a byte of a Buffet, with bft_insert() rules.
+ *
+ * @param[in,out] buf the Buffet
+ * @param[in] off the byte offset, below `buf` length
+ * @param[in] c the byte value
+ * @return false if out of range or on error
+*/
+bool
+bft_setbyte (Buffet *buf, size_t off, char c)
+{
+    if (off >= bft_len(buf)) {
+        WARN("offset out of range\n");
+        return false;
+    }
+
+    return splice(buf, off, 1, &c, 1);
+}
+
+
+#define LIST_STACK_MAX (BUFFET_STACK_MEM/sizeof(Buffet))
+
+// Lists end with a tail slot keeping their allocator, so that bft_freelist()
+// releases them to it whatever the caller's. The block starts at the list :
+// with the system allocator, free() releases it as well.
+typedef struct {
+    const BuffetAllocator *mem;
+} ListTail;
+
+_Static_assert(sizeof(ListTail) <= sizeof(Buffet), "ListTail fits a slot");
+
+#define LISTMEM(cnt) (((cnt)+1)*sizeof(Buffet))
+#define LISTTAIL(list, cnt) ((ListTail*)((list)+(cnt)))
+
+// record `mem` in the tail of a list of `cnt` Buffets
+static inline Buffet*
+list_seal (Buffet *list, size_t cnt, const BuffetAllocator *mem)
+{
+    LISTTAIL(list, cnt)->mem = mem;
+    return list;
+}
+
+static void
+list_free (Buffet *list, size_t cnt) {
+    MEM_FREE(LISTTAIL(list, cnt)->mem, list, LISTMEM(cnt));
+}
+
+// bounded search of `sep` in `src`
+static inline const char*
+find (const char *src, size_t srclen, const char *sep, size_t seplen) {
+    return find_kernel(src, srclen, sep, seplen);
+}
+
+/**
+ * Find the first occurrence of a separator in a bytes source.
+ * Linear in `srclen` whatever the input, with the selected vector kernels.
+ *
+ * @param[in] src the bytes source
+ * @param[in] srclen the source length in bytes
+ * @param[in] sep the separator
+ * @param[in] seplen the separator length in bytes
+ * @return the occurrence in `src`, or NULL if none or `seplen` is zero
+*/
+const char*
+bft_find (const char *src, size_t srclen, const char *sep, size_t seplen) {
+    return seplen ? find(src, srclen, sep, seplen) : NULL;
+}
+
+/**
+ * Split a bytes source into a list of Buffets.
+ *
+ * @param[in] src the bytes source
+ * @param[in] srclen the source length in bytes
+ * @param[in] sep the separator string
+ * @param[in] seplen the separator length in bytes
+ * @param[out] outcnt the resulting list length
+ * @return the resulting parts Buffet array
+*/
+Buffet*
+bft_split (const char* src, size_t srclen, const char* sep, size_t seplen, 
+    int *outcnt)
+{
+    int curcnt = 0; 
+    Buffet *ret = NULL;
+    const BuffetAllocator *mem = getmem();
+    
+    Buffet parts_local[LIST_STACK_MAX]; 
+    Buffet *parts = parts_local;
+    bool local = true;
+    int partsmax = LIST_STACK_MAX;
+
+    const char *beg = src;
+    const char *end = beg;
+    const char *srcend = src+srclen;
+
+    // empty separator : one part
+    while (seplen && (end = find(beg, srcend-beg, sep, seplen))) {
+
+        if (curcnt >= partsmax-1) {
+
+            const size_t cursz = LISTMEM(partsmax);
+            partsmax *= 2;
+            const size_t newsz = LISTMEM(partsmax);
+
+            if (local) {
+                parts = MEM_ALLOC(mem, newsz); 
+                if (!parts) {ERR_ALLOC; curcnt = 0; goto fin;}
+                memcpy(parts, parts_local, curcnt * sizeof(Buffet));
+                local = false;
+            } else {
+                Buffet *grown = MEM_REALLOC(mem, parts, cursz, newsz); 
+                if (!grown) {
+                    ERR_ALLOC;
+                    MEM_FREE(mem, parts, cursz);
+                    curcnt = 0; 
+                    goto fin;
+                }
+                parts = grown;
+            }
+        }
+
+        parts[curcnt++] = new_vue(beg, end-beg);
+        beg = end+seplen;
+    };
+    
+    // last part
+    parts[curcnt++] = new_vue(beg, srcend-beg);
+
+    // exact size, and the tail
+    if (local) {
+        ret = MEM_ALLOC(mem, LISTMEM(curcnt));
+        if (!ret) {ERR_ALLOC; curcnt = 0; goto fin;}
+        memcpy(ret, parts, curcnt * sizeof(Buffet));
+    } else {
+        const size_t cursz = LISTMEM(partsmax);
+        ret = MEM_REALLOC(mem, parts, cursz, LISTMEM(curcnt));
+        if (!ret) {
+            ERR_ALLOC;
+            MEM_FREE(mem, parts, cursz);
+            curcnt = 0;
+            goto fin;
+        }
+    }
+    list_seal(ret, curcnt, mem);
+
+    fin:
+    *outcnt = curcnt;
+
+    return ret;
 }
 
 
@@ -751,6 +1625,90 @@ bft_splitstr (const char* src, const char* sep, int *outcnt) {
 }
 
 
+/**
+ * Split a Buffet into a list of Buffets that may outlive it.
+ * - if `src` is OWN, parts are OWN views on its store, 
+ *   whose refcount is raised once by their number.
+ * - if `src` is SSO or SSV, parts are SSO copies.
+ * - if `src` is VUE, parts are VUEs on the same target.
+ * Empty parts are empty SSOs.
+ * Release the list with bft_freelist().
+ *
+ * @param[in] src the source Buffet
+ * @param[in] sep the separator string
+ * @param[in] seplen the separator length in bytes
+ * @param[out] outcnt the resulting list length
+ * @return the resulting parts Buffet array
+*/
+Buffet*
+bft_split_buf (Buffet *src, const char* sep, size_t seplen, int *outcnt)
+{
+    Tag tag = TAG(src);
+    const char *data = getdata(src,tag);
+    Store *store = NULL;
+
+    if (tag==OWN) {
+        store = getstore(src);
+        #if MEMCHECK
+            if (store->canary != CANARY) {
+                WARN_CANARY; 
+                *outcnt = 0;
+                return NULL;
+            }
+        #endif
+    }
+
+    Buffet *parts = bft_split(data, getlen(src,tag), sep, seplen, outcnt);
+    if (!parts || tag==VUE) return parts;
+
+    const int cnt = *outcnt;
+    int refs = 0;
+
+    for (int i = 0; i < cnt; ++i) {
+
+        Buffet *part = &parts[i];
+        const char *partdata = part->ptr.data;
+        const size_t partlen = part->ptr.len;
+
+        if (!partlen) {
+            *part = ZERO;
+        } else if (tag==OWN) {
+            part->ptr.off = src->ptr.off + (partdata-data);
+            part->ptr.tag = OWN;
+            ++ refs;
+        } else {
+            // part of an SSO fits an SSO
+            *part = bft_memcopy(partdata, partlen);
+        }
+    }
+
+    if (refs) REF_ADD(store, refs);
+
+    return parts;
+}
+
+
+/**
+ * Discard a list returned by split or bft_column_views.
+ * Each element is released by bft_free, then the list itself,
+ * by the allocator it was made with.
+ * 
+ * @param[in] list the Buffet array
+ * @param[in] cnt the array length, as returned with it
+ */
+void
+bft_freelist (Buffet *list, int cnt)
+{
+    if (!list) return;
+
+    for (int i = 0; i < cnt; ++i) {
+        bft_free(&list[i]);
+    }
+
+    list_free(list, cnt);
+}
+
+
 /**
  * Join a list of Buffet along a separator into a new Buffet.
  *
@@ -763,10 +1721,16 @@ bft_splitstr (const char* src, const char* sep, int *outcnt) {
 Buffet 
 bft_join (const Buffet *parts, int cnt, const char* sep, size_t seplen)
 {
+    if (cnt <= 0) return ZERO;
+
     // optim: local if small; none if too big ?
-    size_t *lengths = malloc(cnt*sizeof(*lengths));
+    const BuffetAllocator *mem = getmem();
+    const size_t lengths_sz = cnt*sizeof(size_t);
+    size_t *lengths = MEM_ALLOC(mem, lengths_sz);
     size_t totlen = 0;
 
+    if (!lengths) {ERR_ALLOC; return ZERO;}
+
     for (int i=0; i < cnt; ++i) {
         const Buffet *part = &parts[i];
         size_t len = getlen(part,TAG(part));
@@ -778,6 +1742,12 @@ bft_join (const Buffet *parts, int cnt, const char* sep, size_t seplen)
     
     Buffet ret = bft_new(totlen);
     const Tag rettag = TAG(&ret);
+
+    if (totlen > BUFFET_SSOMAX && rettag != OWN) {
+        MEM_FREE(mem, lengths, lengths_sz);
+        return ZERO;
+    }
+
     char* cur = getdata(&ret,rettag);
     cur[totlen] = 0; 
 
@@ -797,7 +1767,7 @@ bft_join (const Buffet *parts, int cnt, const char* sep, size_t seplen)
     if (rettag==SSO) ret.sso.len = totlen; 
     else ret.ptr.len = totlen;
 
-    free(lengths);
+    MEM_FREE(mem, lengths, lengths_sz);
 
     return ret;
 }
@@ -957,3 +1927,1365 @@ void
 bft_dbg (const Buffet* buf) {
     dbg(buf);
 }
+
+//============================================================================
+// Compact 16 bytes handle
+//============================================================================
+
+#define CTAG(buf) ((buf)->sso.tag)
+#define CTAGMASK ((uintptr_t)3)
+#define CZERO ((BuffetCompact){.fill={0}})
+
+static inline Store*
+cgetstore (const BuffetCompact *buf) {
+    return (Store*)(buf->ptr.ptr & ~CTAGMASK);
+}
+
+static inline const char*
+cgetdata (const BuffetCompact *buf, Tag tag) 
+{
+    switch (tag) {
+        case SSO: return buf->sso.data;
+        case OWN: return cgetstore(buf)->data + buf->ptr.off;
+        default:  return (const char*)(buf->ptr.ptr & ~CTAGMASK) + buf->ptr.off;
+    }
+}
+
+static inline BuffetCompact
+new_cvue (const char *src, size_t len)
+{
+    uintptr_t addr = (uintptr_t)src;
+    return (BuffetCompact) {
+        .ptr.ptr = (addr & ~CTAGMASK) | VUE,
+        .ptr.len = len,
+        .ptr.off = addr & CTAGMASK
+    };
+}
+
+static inline BuffetCompact
+new_csso (const char *src, size_t len)
+{
+    BuffetCompact ret = CZERO;
+    memcpy(ret.sso.data, src, len);
+    ret.sso.len = len;
+    return ret;
+}
+
+/**
+ * Create a new compact Buffet copying a range of bytes.
+ * Data over BUFFET_COMPACT_SSOMAX goes to an exact-size store.
+ * @param[in] src the source address
+ * @param[in] len the length of the copy, up to 4GB
+ */
+BuffetCompact
+bftc_memcopy (const char *src, size_t len)
+{
+    if (len <= BUFFET_COMPACT_SSOMAX) return new_csso(src, len);
+
+    if (len > UINT32_MAX) {
+        ERR("compact Buffet length over 4GB\n");
+        return CZERO;
+    }
+
+    Store *store = new_store(len, len);
+    if (!store) return CZERO;
+
+    memcpy(store->data, src, len);
+    store->data[len] = 0;
+
+    return (BuffetCompact) {
+        .ptr.ptr = (uintptr_t)store | OWN,
+        .ptr.len = len,
+        .ptr.off = 0
+    };
+}
+
+/**
+ * Create a new compact Buffet viewing a range of bytes.
+ * @param[in] src the source address
+ * @param[in] len the length of the view, up to 4GB
+ */
+BuffetCompact
+bftc_memview (const char *src, size_t len)
+{
+    if (len > UINT32_MAX) {
+        ERR("compact Buffet length over 4GB\n");
+        return CZERO;
+    }
+    return new_cvue(src, len);
+}
+
+/**
+ * Create a new compact Buffet viewing a compact Buffet.
+ * Same as bft_view, except that viewing an SSO makes an SSO copy.
+ * @param[in] src the source
+ * @param[in] off offset to start from
+ * @param[in] len length in bytes
+ */
+BuffetCompact
+bftc_view (BuffetCompact *src, size_t off, size_t len)
+{
+    Tag tag = CTAG(src);
+    size_t srclen = bftc_len(src);
+
+    if (!len||off>=srclen) return CZERO;
+    // clipping
+    if (off+len > srclen) len = srclen-off;
+
+    switch(tag) {
+
+        case SSO:
+            return new_csso(src->sso.data + off, len);
+
+        case OWN: {
+            Store *store = cgetstore(src);
+            #if MEMCHECK
+                if (store->canary != CANARY) {WARN_CANARY; return CZERO;}
+            #endif
+
+            REF_ADD(store, 1);
+
+            BuffetCompact ret = *src;
+            ret.ptr.off += off;
+            ret.ptr.len = len;
+            return ret;
+        }
+
+        default:
+            return new_cvue(cgetdata(src, tag) + off, len);
+    }
+}
+
+/**
+ * Create a shallow copy of a compact Buffet.
+ * @param[in] src the source
+ */
+BuffetCompact
+bftc_dup (const BuffetCompact *src)
+{
+    if (CTAG(src) == OWN) {
+        Store *store = cgetstore(src);
+        #if MEMCHECK
+            if (store->canary != CANARY) {WARN_CANARY; return CZERO;}
+        #endif
+        REF_ADD(store, 1);
+    }
+
+    return *src;
+}
+
+/**
+ * Discard a compact Buffet.
+ * If it was the last co-owner of a store, the store is released.
+ * @param[in] buf the target
+ */
+void
+bftc_free (BuffetCompact *buf)
+{
+    if (CTAG(buf) == OWN) {
+        Store *store = cgetstore(buf);
+        #if MEMCHECK
+            if (store->canary != CANARY) {WARN_CANARY; *buf = CZERO; return;}
+        #endif
+        unref_store(store);
+    }
+
+    *buf = CZERO;
+}
+
+/**
+ * Get a compact Buffet data.
+ * Rem: an SSO of length BUFFET_COMPACT_SSOMAX is not null-terminated.
+ * @param[in] buf the source
+ */
+const char*
+bftc_data (const BuffetCompact *buf) {
+    return cgetdata(buf, CTAG(buf));
+}
+
+/**
+ * Get a compact Buffet length.
+ * @param[in] buf the source
+ */
+size_t
+bftc_len (const BuffetCompact *buf) {
+    return CTAG(buf) == SSO ? buf->sso.len : buf->ptr.len;
+}
+
+/**
+ * Get the heap memory a compact Buffet keeps alive.
+ * @see bft_retained
+ * @param[in] buf the source
+ */
+size_t
+bftc_retained (const BuffetCompact *buf)
+{
+    if (CTAG(buf) != OWN) return 0;
+
+    const Store *store = cgetstore(buf);
+    #if MEMCHECK
+        if (store->canary != CANARY) {WARN_CANARY; return 0;}
+    #endif
+
+    return STOREMEM(store->cap);
+}
+
+//============================================================================
+// Column
+//============================================================================
+
+#define COLUMN_OFFMAX ((BuffetColumnOff)-1)
+
+// grow `col` to hold exactly `cnt` strings of `datalen` total bytes
+static bool
+column_reserve (BuffetColumn *col, size_t cnt, size_t datalen)
+{
+    // zeroed column
+    if (!col->mem) col->mem = getmem();
+    const BuffetAllocator *mem = col->mem;
+
+    if (datalen > col->datacap || !col->data) {
+        size_t newcap = datalen;
+        // +1 for a final nul, as bft_cstr peeks past the last view
+        char *data = col->data
+            ? MEM_REALLOC(mem, col->data, col->datacap+1, newcap+1)
+            : MEM_ALLOC(mem, newcap+1);
+        if (!data) {ERR_ALLOC; return false;}
+        col->data = data;
+        col->datacap = newcap;
+    }
+
+    // one more offset for the end of the last string
+    if (cnt+1 > col->offscap) {
+        size_t newcap = cnt+1;
+        BuffetColumnOff *offs = col->offs
+            ? MEM_REALLOC(mem, col->offs, 
+                col->offscap*sizeof(*offs), newcap*sizeof(*offs))
+            : MEM_ALLOC(mem, newcap*sizeof(*offs));
+        if (!offs) {ERR_ALLOC; return false;}
+        col->offs = offs;
+        col->offscap = newcap;
+    }
+
+    return true;
+}
+
+/**
+ * Create a new empty column.
+ * Rem: allocation uses the allocator in effect at creation.
+ * @param[in] cnt expected number of strings
+ * @param[in] datalen expected total length
+ */
+BuffetColumn
+bft_column_new (size_t cnt, size_t datalen)
+{
+    BuffetColumn ret = {.mem = getmem()};
+
+    column_reserve(&ret, cnt, datalen);
+    if (ret.offs) ret.offs[0] = 0;
+
+    return ret;
+}
+
+/**
+ * Create a column packing a list of Buffets.
+ * @param[out] col the new column, empty on failure
+ * @param[in] list the Buffet source array
+ * @param[in] cnt the source array length
+ * @return false on allocation failure or offsets overflow
+ */
+bool
+bft_column_from (BuffetColumn *col, const Buffet *list, int cnt)
+{
+    size_t datalen = 0;
+    for (int i = 0; i < cnt; ++i) datalen += bft_len(&list[i]);
+
+    *col = bft_column_new(cnt, datalen);
+
+    for (int i = 0; i < cnt; ++i) {
+        const Buffet *elt = &list[i];
+        Tag tag = TAG(elt);
+        if (!bft_column_append(col, getdata(elt,tag), getlen(elt,tag))) {
+            bft_column_free(col);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Append a string to a column.
+ * @param[in,out] col the column
+ * @param[in] src the byte array source
+ * @param[in] len the source length
+ * @return false on allocation failure or offsets overflow
+ */
+bool
+bft_column_append (BuffetColumn *col, const char *src, size_t len)
+{
+    const size_t newlen = col->datalen + len;
+
+    if (newlen > COLUMN_OFFMAX) {
+        ERR("column offsets overflow\n");
+        return false;
+    }
+
+    const size_t newcnt = col->cnt+1;
+    const bool growdata = newlen > col->datacap || !col->data;
+    const bool growoffs = newcnt+1 > col->offscap;
+
+    if ((growdata || growoffs)
+    && !column_reserve(col, growoffs ? OVERALLOC*newcnt : newcnt,
+                            growdata ? OVERALLOC*newlen : newlen))
+        return false;
+
+    if (len) memcpy(col->data + col->datalen, src, len);
+    col->data[newlen] = 0;
+    col->datalen = newlen;
+    col->offs[0] = 0; // in case of a zeroed col
+    col->offs[++ col->cnt] = newlen;
+
+    return true;
+}
+
+/**
+ * Get a view of a column string.
+ * @param[in] col the column
+ * @param[in] i the string index
+ * @return a VUE, or an empty Buffet if `i` is out of range
+ */
+Buffet
+bft_column_get (const BuffetColumn *col, size_t i)
+{
+    if (i >= col->cnt) return ZERO;
+
+    const BuffetColumnOff beg = col->offs[i];
+    return new_vue(col->data + beg, col->offs[i+1] - beg);
+}
+
+/**
+ * Get the number of strings in a column.
+ * @param[in] col the column
+ */
+size_t
+bft_column_count (const BuffetColumn *col) {
+    return col->cnt;
+}
+
+/**
+ * Get the column strings as a list of views.
+ * Release the list with bft_freelist().
+ * @param[in] col the column
+ * @param[out] outcnt the resulting list length
+ * @return the resulting VUE array, NULL if the column is empty or 
+ * has more than INT_MAX strings
+ */
+Buffet*
+bft_column_views (const BuffetColumn *col, int *outcnt)
+{
+    *outcnt = 0;
+    if (!col->cnt) return NULL;
+    if (col->cnt > INT_MAX) {
+        ERR("column too large for a list\n");
+        return NULL;
+    }
+
+    const int cnt = col->cnt;
+    const BuffetAllocator *mem = getmem();
+    Buffet *ret = MEM_ALLOC(mem, LISTMEM(cnt));
+
+    if (!ret) {
+        ERR_ALLOC; 
+        return NULL;
+    }
+
+    for (int i = 0; i < cnt; ++i) ret[i] = bft_column_get(col, i);
+    
+    *outcnt = cnt;
+    return list_seal(ret, cnt, mem);
+}
+
+/**
+ * Discard a column. Its views become invalid.
+ * @param[in] col the column
+ */
+void
+bft_column_free (BuffetColumn *col)
+{
+    const BuffetAllocator *mem = col->mem;
+
+    if (mem) {
+        if (col->data) MEM_FREE(mem, col->data, col->datacap+1);
+        if (col->offs) MEM_FREE(mem, col->offs, 
+            col->offscap*sizeof(BuffetColumnOff));
+    }
+
+    *col = (BuffetColumn){0};
+}
+
+//============================================================================
+// Dict
+//============================================================================
+
+#define DICT_BLOCK BUFFET_DICT_BLOCK
+#define DICT_STACK 256 // decoding scratch on stack up to this key length
+
+// write `n` as LEB128 into `dst` (if not NULL), return its size
+static size_t
+put_varint (char *dst, size_t n)
+{
+    size_t ret = 0;
+    do {
+        uint8_t byte = n & 0x7f;
+        n >>= 7;
+        if (dst) dst[ret] = byte | (n ? 0x80 : 0);
+        ++ret;
+    } while (n);
+
+    return ret;
+}
+
+static const char*
+get_varint (const char *src, size_t *n)
+{
+    size_t ret = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+        byte = *src++;
+        ret |= (size_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *n = ret;
+    return src;
+}
+
+// full key heading block `b`, in place
+static const char*
+dict_head (const BuffetDict *dict, size_t b, size_t *len) {
+    return get_varint(dict->data + dict->blocks[b], len);
+}
+
+// decode the entry at `pos` over the previous `key`, return next entry
+static const char*
+dict_next (const char *pos, char *key, size_t *len)
+{
+    size_t shared, suflen;
+    pos = get_varint(pos, &shared);
+    pos = get_varint(pos, &suflen);
+    memcpy(key+shared, pos, suflen);
+    *len = shared + suflen;
+    return pos + suflen;
+}
+
+// compare `key` to `t`, or only its first `tlen` bytes if `prefix`
+static int
+dict_cmp (const char *key, size_t klen, const char *t, size_t tlen, bool prefix)
+{
+    if (prefix && klen > tlen) klen = tlen;
+    const size_t n = klen < tlen ? klen : tlen;
+    const int cmp = n ? memcmp(key, t, n) : 0;
+    return cmp ? cmp : (klen > tlen) - (klen < tlen);
+}
+
+#define DICT_BEFORE(cmp, prefix) ((prefix) ? (cmp) <= 0 : (cmp) < 0)
+
+// Index of the first key not before `t`.
+// With `prefix`, index of the first key past those starting with `t`.
+// `scratch` receives decoded keys. `eq` tells if the key found equals `t`.
+static size_t
+dict_bound (const BuffetDict *dict, const char *t, size_t tlen, bool prefix,
+    char *scratch, bool *eq)
+{
+    const size_t nblocks = (dict->cnt + DICT_BLOCK-1) / DICT_BLOCK;
+    const char *key;
+    size_t klen;
+    int cmp;
+
+    // first block whose head is not before `t`
+    size_t lo = 0, hi = nblocks;
+    while (lo < hi) {
+        const size_t mid = lo + (hi-lo)/2;
+        key = dict_head(dict, mid, &klen);
+        cmp = dict_cmp(key, klen, t, tlen, prefix);
+        if (DICT_BEFORE(cmp, prefix)) lo = mid+1; else hi = mid;
+    }
+
+    *eq = false;
+
+    // scan the previous block, whose head is before `t`
+    if (lo) {
+        const size_t beg = (lo-1)*DICT_BLOCK;
+        const size_t end = beg+DICT_BLOCK < dict->cnt ? beg+DICT_BLOCK : dict->cnt;
+        key = dict_head(dict, lo-1, &klen);
+        memcpy(scratch, key, klen);
+        const char *pos = key + klen;
+
+        for (size_t i = beg+1; i < end; ++i) {
+            pos = dict_next(pos, scratch, &klen);
+            cmp = dict_cmp(scratch, klen, t, tlen, prefix);
+            if (!DICT_BEFORE(cmp, prefix)) {
+                *eq = !cmp;
+                return i;
+            }
+        }
+    }
+
+    if (lo == nblocks) return dict->cnt;
+
+    key = dict_head(dict, lo, &klen);
+    *eq = !dict_cmp(key, klen, t, tlen, prefix);
+    return lo*DICT_BLOCK;
+}
+
+static char*
+dict_scratch (const BuffetDict *dict, char *stack)
+{
+    if (dict->maxlen <= DICT_STACK) return stack;
+
+    char *ret = MEM_ALLOC(dict->mem, dict->maxlen);
+    if (!ret) ERR_ALLOC;
+    return ret;
+}
+
+static void
+dict_unscratch (const BuffetDict *dict, char *scratch, char *stack) {
+    if (scratch != stack) MEM_FREE(dict->mem, scratch, dict->maxlen);
+}
+
+/**
+ * Create a front-coded dictionary from a sorted list of Buffets.
+ * Rem: allocation uses the allocator in effect at creation.
+ * @param[in] sorted the keys, in bft_cmp order
+ * @param[in] cnt the number of keys
+ * @return the dictionary, empty if `sorted` is not sorted
+ */
+BuffetDict
+bft_dict_from (const Buffet *sorted, int cnt)
+{
+    BuffetDict ret = {.mem = getmem()};
+    if (cnt <= 0) return ret;
+
+    // check order and size the encoding
+    size_t datalen = 0;
+    size_t maxlen = 0;
+    const char *prev = NULL;
+    size_t prevlen = 0;
+
+    for (int i = 0; i < cnt; ++i) {
+        const Buffet *elt = &sorted[i];
+        const char *key = getdata(elt, TAG(elt));
+        const size_t len = getlen(elt, TAG(elt));
+
+        if (prev && dict_cmp(prev, prevlen, key, len, false) > 0) {
+            ERR("dict keys not sorted\n");
+            return ret;
+        }
+
+        if (i % DICT_BLOCK) {
+            size_t shared = 0;
+            while (shared < len && shared < prevlen && key[shared] == prev[shared])
+                ++shared;
+            datalen += put_varint(NULL, shared) + put_varint(NULL, len-shared)
+                    + len-shared;
+        } else {
+            datalen += put_varint(NULL, len) + len;
+        }
+
+        if (len > maxlen) maxlen = len;
+        prev = key;
+        prevlen = len;
+    }
+
+    const size_t nblocks = (cnt + DICT_BLOCK-1) / DICT_BLOCK;
+    ret.data = MEM_ALLOC(ret.mem, datalen);
+    ret.blocks = MEM_ALLOC(ret.mem, nblocks*sizeof(size_t));
+
+    if (!ret.data || !ret.blocks) {
+        ERR_ALLOC;
+        if (ret.data) MEM_FREE(ret.mem, ret.data, datalen);
+        if (ret.blocks) MEM_FREE(ret.mem, ret.blocks, nblocks*sizeof(size_t));
+        return (BuffetDict){.mem = ret.mem};
+    }
+
+    // encode
+    char *pos = ret.data;
+    for (int i = 0; i < cnt; ++i) {
+        const Buffet *elt = &sorted[i];
+        const char *key = getdata(elt, TAG(elt));
+        const size_t len = getlen(elt, TAG(elt));
+        size_t shared = 0;
+
+        if (i % DICT_BLOCK) {
+            while (shared < len && shared < prevlen && key[shared] == prev[shared])
+                ++shared;
+            pos += put_varint(pos, shared);
+            pos += put_varint(pos, len-shared);
+        } else {
+            ret.blocks[i/DICT_BLOCK] = pos - ret.data;
+            pos += put_varint(pos, len);
+        }
+
+        memcpy(pos, key+shared, len-shared);
+        pos += len-shared;
+        prev = key;
+        prevlen = len;
+    }
+
+    ret.datalen = datalen;
+    ret.cnt = cnt;
+    ret.maxlen = maxlen;
+
+    return ret;
+}
+
+/**
+ * Find a key in a dictionary.
+ * @param[in] dict the dictionary
+ * @param[in] key the key
+ * @return the key index, or -1 if absent
+ */
+long
+bft_dict_find (const BuffetDict *dict, const Buffet *key)
+{
+    char stack[DICT_STACK];
+    char *scratch = dict_scratch(dict, stack);
+    if (!scratch) return -1;
+
+    bool eq;
+    const size_t i = dict_bound(dict, getdata(key, TAG(key)),
+        getlen(key, TAG(key)), false, scratch, &eq);
+
+    dict_unscratch(dict, scratch, stack);
+    return eq ? (long)i : -1;
+}
+
+/**
+ * Find the range of keys starting with a prefix.
+ * @param[in] dict the dictionary
+ * @param[in] prefix the prefix
+ * @param[out] first index of the first matching key
+ * @return the number of matching keys
+ */
+long
+bft_dict_prefix (const BuffetDict *dict, const Buffet *prefix, long *first)
+{
+    char stack[DICT_STACK];
+    char *scratch = dict_scratch(dict, stack);
+    *first = 0;
+    if (!scratch) return 0;
+
+    const char *t = getdata(prefix, TAG(prefix));
+    const size_t tlen = getlen(prefix, TAG(prefix));
+    bool eq;
+    const size_t beg = dict_bound(dict, t, tlen, false, scratch, &eq);
+    const size_t end = dict_bound(dict, t, tlen, true, scratch, &eq);
+
+    dict_unscratch(dict, scratch, stack);
+    *first = beg;
+    return end - beg;
+}
+
+/**
+ * Decode a dictionary key.
+ * @param[in] dict the dictionary
+ * @param[in] i the key index
+ * @return a new Buffet, or an empty Buffet if `i` is out of range
+ */
+Buffet
+bft_dict_get (const BuffetDict *dict, long i)
+{
+    if (i < 0 || (size_t)i >= dict->cnt) return ZERO;
+
+    size_t len;
+    const char *key = dict_head(dict, i/DICT_BLOCK, &len);
+    if (!(i % DICT_BLOCK)) return bft_memcopy(key, len);
+
+    char stack[DICT_STACK];
+    char *scratch = dict_scratch(dict, stack);
+    if (!scratch) return ZERO;
+
+    memcpy(scratch, key, len);
+    const char *pos = key + len;
+    for (long k = 0; k < i % DICT_BLOCK; ++k) pos = dict_next(pos, scratch, &len);
+
+    Buffet ret = bft_memcopy(scratch, len);
+    dict_unscratch(dict, scratch, stack);
+    return ret;
+}
+
+/**
+ * Get the number of keys in a dictionary.
+ * @param[in] dict the dictionary
+ */
+size_t
+bft_dict_count (const BuffetDict *dict) {
+    return dict->cnt;
+}
+
+/**
+ * Get the heap memory held by a dictionary.
+ * @param[in] dict the dictionary
+ */
+size_t
+bft_dict_retained (const BuffetDict *dict) {
+    return dict->datalen
+         + (dict->cnt + DICT_BLOCK-1) / DICT_BLOCK * sizeof(size_t);
+}
+
+/**
+ * Discard a dictionary.
+ * @param[in] dict the dictionary
+ */
+void
+bft_dict_free (BuffetDict *dict)
+{
+    const BuffetAllocator *mem = dict->mem;
+    const size_t nblocks = (dict->cnt + DICT_BLOCK-1) / DICT_BLOCK;
+
+    if (mem) {
+        if (dict->data) MEM_FREE(mem, dict->data, dict->datalen);
+        if (dict->blocks) MEM_FREE(mem, dict->blocks, nblocks*sizeof(size_t));
+    }
+
+    *dict = (BuffetDict){0};
+}
+
+//============================================================================
+// Art
+//============================================================================
+
+#define ART_PREFIX BUFFET_SSOMAX // path bytes held by a node, as an SSO
+
+// leaves are tagged children
+#define ART_ISLEAF(p) ((uintptr_t)(p) & 1)
+#define ART_LEAF(p) ((ArtLeaf*)((uintptr_t)(p) & ~(uintptr_t)1))
+#define ART_TAGLEAF(leaf) ((void*)((uintptr_t)(leaf) | 1))
+
+typedef struct {
+    Buffet key;
+    void  *val;
+} ArtLeaf;
+
+typedef enum {NODE4, NODE16, NODE48, NODE256} ArtType;
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  plen;
+    uint16_t cnt;
+    char     prefix[ART_PREFIX];
+    ArtLeaf *leaf; // key ending at this node
+} ArtNode;
+
+// Node4 and Node16 keys are sorted. Node48 index holds slot+1.
+typedef struct {ArtNode n; uint8_t keys[4]; void *child[4];} ArtNode4;
+typedef struct {ArtNode n; uint8_t keys[16]; void *child[16];} ArtNode16;
+typedef struct {ArtNode n; uint8_t index[256]; void *child[48];} ArtNode48;
+typedef struct {ArtNode n; void *child[256];} ArtNode256;
+
+static const size_t art_nodesize[] = {
+    sizeof(ArtNode4), sizeof(ArtNode16), sizeof(ArtNode48), sizeof(ArtNode256)
+};
+
+static ArtNode*
+art_node (const BuffetAllocator *mem, ArtType type)
+{
+    ArtNode *ret = MEM_ALLOC(mem, art_nodesize[type]);
+    if (!ret) {ERR_ALLOC; return NULL;}
+
+    memset(ret, 0, art_nodesize[type]);
+    ret->type = type;
+    return ret;
+}
+
+static ArtLeaf*
+art_leaf (const BuffetAllocator *mem, const Buffet *key, void *val)
+{
+    ArtLeaf *ret = MEM_ALLOC(mem, sizeof(ArtLeaf));
+    if (!ret) {ERR_ALLOC; return NULL;}
+
+    // as bft_copyall : share an owned store the key fills, copy otherwise
+    const Tag tag = TAG(key);
+    ret->key = copy_range(key, tag, 0, getlen(key, tag));
+    ret->val = val;
+    return ret;
+}
+
+static void
+art_freenode (const BuffetAllocator *mem, void *p)
+{
+    if (!p) return;
+
+    if (ART_ISLEAF(p)) {
+        ArtLeaf *leaf = ART_LEAF(p);
+        bft_free(&leaf->key);
+        MEM_FREE(mem, leaf, sizeof(ArtLeaf));
+        return;
+    }
+
+    ArtNode *node = p;
+    if (node->leaf) art_freenode(mem, ART_TAGLEAF(node->leaf));
+
+    switch (node->type) {
+        case NODE4:
+            for (int i = 0; i < node->cnt; ++i)
+                art_freenode(mem, ((ArtNode4*)node)->child[i]);
+            break;
+        case NODE16:
+            for (int i = 0; i < node->cnt; ++i)
+                art_freenode(mem, ((ArtNode16*)node)->child[i]);
+            break;
+        case NODE48:
+            for (int i = 0; i < node->cnt; ++i)
+                art_freenode(mem, ((ArtNode48*)node)->child[i]);
+            break;
+        default:
+            for (int i = 0; i < 256; ++i)
+                art_freenode(mem, ((ArtNode256*)node)->child[i]);
+    }
+
+    MEM_FREE(mem, node, art_nodesize[node->type]);
+}
+
+// 16 keys fit one SSE2 compare, AVX2 has nothing to add.
+// Dispatched by a branch on the tier rather than a call, as it is inlined.
+#if ISA_X86
+__attribute__((target("sse2")))
+static inline int
+node16_find_sse2 (const ArtNode16 *node, uint8_t c)
+{
+    const __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(c),
+        _mm_loadu_si128((const __m128i*)node->keys));
+    const unsigned mask = _mm_movemask_epi8(cmp) & ((1u << node->n.cnt) - 1);
+    return mask ? __builtin_ctz(mask) : -1;
+}
+#endif
+
+static inline int
+node16_find (const ArtNode16 *node, uint8_t c)
+{
+#if ISA_X86
+    if (isa_level >= ISA_SSE2) return node16_find_sse2(node, c);
+#endif
+    for (int i = 0; i < node->n.cnt; ++i) if (node->keys[i] == c) return i;
+    return -1;
+}
+
+// slot of the child at byte `c`, or NULL
+static void**
+art_child (ArtNode *node, uint8_t c)
+{
+    switch (node->type) {
+        case NODE4: {
+            ArtNode4 *n = (ArtNode4*)node;
+            for (int i = 0; i < node->cnt; ++i)
+                if (n->keys[i] == c) return &n->child[i];
+            return NULL;
+        }
+        case NODE16: {
+            ArtNode16 *n = (ArtNode16*)node;
+            const int i = node16_find(n, c);
+            return (i < 0) ? NULL : &n->child[i];
+        }
+        case NODE48: {
+            ArtNode48 *n = (ArtNode48*)node;
+            return n->index[c] ? &n->child[n->index[c]-1] : NULL;
+        }
+        default: {
+            ArtNode256 *n = (ArtNode256*)node;
+            return n->child[c] ? &n->child[c] : NULL;
+        }
+    }
+}
+
+static void
+art_insert_sorted (uint8_t *keys, void **child, int cnt, uint8_t c, void *ptr)
+{
+    int i = 0;
+    while (i < cnt && keys[i] < c) ++i;
+
+    memmove(keys+i+1, keys+i, cnt-i);
+    memmove(child+i+1, child+i, (cnt-i)*sizeof(void*));
+    keys[i] = c;
+    child[i] = ptr;
+}
+
+// Add child `ptr` at byte `c` to a Node4 with room : never grows nor fails.
+static void
+art_add4 (ArtNode *node, uint8_t c, void *ptr)
+{
+    assert(node->type == NODE4 && node->cnt < 4);
+    ArtNode4 *n = (ArtNode4*)node;
+    art_insert_sorted(n->keys, n->child, node->cnt++, c, ptr);
+}
+
+// Add child `ptr` at byte `c` to the node at `*ref`, growing it if full.
+static bool
+art_add (const BuffetAllocator *mem, void **ref, uint8_t c, void *ptr)
+{
+    ArtNode *node = *ref;
+
+    switch (node->type) {
+        case NODE4: {
+            ArtNode4 *n = (ArtNode4*)node;
+            if (node->cnt < 4) {
+                art_insert_sorted(n->keys, n->child, node->cnt++, c, ptr);
+                return true;
+            }
+            ArtNode16 *big = (ArtNode16*)art_node(mem, NODE16);
+            if (!big) return false;
+            big->n = *node;
+            big->n.type = NODE16;
+            memcpy(big->keys, n->keys, 4);
+            memcpy(big->child, n->child, 4*sizeof(void*));
+            MEM_FREE(mem, node, sizeof(ArtNode4));
+            *ref = big;
+            break;
+        }
+        case NODE16: {
+            ArtNode16 *n = (ArtNode16*)node;
+            if (node->cnt < 16) {
+                art_insert_sorted(n->keys, n->child, node->cnt++, c, ptr);
+                return true;
+            }
+            ArtNode48 *big = (ArtNode48*)art_node(mem, NODE48);
+            if (!big) return false;
+            big->n = *node;
+            big->n.type = NODE48;
+            for (int i = 0; i < 16; ++i) {
+                big->index[n->keys[i]] = i+1;
+                big->child[i] = n->child[i];
+            }
+            MEM_FREE(mem, node, sizeof(ArtNode16));
+            *ref = big;
+            break;
+        }
+        case NODE48: {
+            ArtNode48 *n = (ArtNode48*)node;
+            if (node->cnt < 48) {
+                n->child[node->cnt] = ptr;
+                n->index[c] = ++node->cnt;
+                return true;
+            }
+            ArtNode256 *big = (ArtNode256*)art_node(mem, NODE256);
+            if (!big) return false;
+            big->n = *node;
+            big->n.type = NODE256;
+            for (int b = 0; b < 256; ++b)
+                if (n->index[b]) big->child[b] = n->child[n->index[b]-1];
+            MEM_FREE(mem, node, sizeof(ArtNode48));
+            *ref = big;
+            break;
+        }
+        default: {
+            ArtNode256 *n = (ArtNode256*)node;
+            n->child[c] = ptr;
+            ++node->cnt;
+            return true;
+        }
+    }
+
+    return art_add(mem, ref, c, ptr);
+}
+
+// Nodes holding the path `s` of `len` bytes, chained if longer than ART_PREFIX.
+// Returns the top node, and in `last` the node ending the path.
+static ArtNode*
+art_path (const BuffetAllocator *mem, const char *s, size_t len, ArtNode **last)
+{
+    ArtNode *top = NULL;
+    void **ref = (void**)&top;
+
+    while (1) {
+        ArtNode *node = art_node(mem, NODE4);
+        if (!node) {
+            art_freenode(mem, top);
+            return NULL;
+        }
+        const size_t plen = len < ART_PREFIX ? len : ART_PREFIX;
+        memcpy(node->prefix, s, plen);
+        node->plen = plen;
+        *ref = node;
+
+        if (plen == len) {
+            *last = node;
+            return top;
+        }
+
+        // branch on the next byte to the rest of the path
+        ArtNode4 *n4 = (ArtNode4*)node;
+        n4->keys[0] = s[plen];
+        node->cnt = 1;
+        ref = &n4->child[0];
+        s += plen+1;
+        len -= plen+1;
+    }
+}
+
+/**
+ * Insert a key, or replace its value.
+ * The tree shares the store of an OWN key as bft_copyall() does, or keeps
+ * a copy of the key.
+ * Rem: a zeroed BuffetArt is an empty tree.
+ * @param[in,out] art the tree
+ * @param[in] key the key
+ * @param[in] val the value
+ * @return false on allocation failure
+ */
+bool
+bft_art_insert (BuffetArt *art, const Buffet *key, void *val)
+{
+    if (!art->mem) art->mem = getmem();
+    const BuffetAllocator *mem = art->mem;
+    const Tag tag = TAG(key);
+    const char *k = getdata(key, tag);
+    const size_t len = getlen(key, tag);
+    void **ref = &art->root;
+    size_t depth = 0;
+
+    while (*ref) {
+
+        if (ART_ISLEAF(*ref)) {
+            ArtLeaf *leaf = ART_LEAF(*ref);
+            const char *lk = getdata(&leaf->key, TAG(&leaf->key));
+            const size_t llen = getlen(&leaf->key, TAG(&leaf->key));
+
+            if (llen == len && !memcmp(lk, k, len)) {
+                leaf->val = val;
+                return true;
+            }
+
+            // branch both keys where they differ
+            size_t common = 0;
+            while (depth+common < len && depth+common < llen
+            && k[depth+common] == lk[depth+common]) ++common;
+
+            ArtLeaf *new = art_leaf(mem, key, val);
+            ArtNode *last;
+            ArtNode *top = new ? art_path(mem, k+depth, common, &last) : NULL;
+            if (!top) {
+                if (new) art_freenode(mem, ART_TAGLEAF(new));
+                return false;
+            }
+
+            // a fresh Node4, given at most two children
+            depth += common;
+            if (depth == llen) last->leaf = leaf;
+            else art_add4(last, lk[depth], *ref);
+            if (depth == len) last->leaf = new;
+            else art_add4(last, k[depth], ART_TAGLEAF(new));
+
+            *ref = top;
+            ++art->cnt;
+            return true;
+        }
+
+        ArtNode *node = *ref;
+        size_t match = 0;
+        while (match < node->plen && depth+match < len
+        && node->prefix[match] == k[depth+match]) ++match;
+
+        if (match < node->plen) {
+            // split the path : a new parent holds the matched part
+            ArtLeaf *new = art_leaf(mem, key, val);
+            ArtNode *parent = new ? art_node(mem, NODE4) : NULL;
+            if (!parent) {
+                if (new) art_freenode(mem, ART_TAGLEAF(new));
+                return false;
+            }
+
+            memcpy(parent->prefix, node->prefix, match);
+            parent->plen = match;
+            const uint8_t c = node->prefix[match];
+            node->plen -= match+1;
+            memmove(node->prefix, node->prefix+match+1, node->plen);
+            art_add4(parent, c, node);
+
+            if (depth+match == len) parent->leaf = new;
+            else art_add4(parent, k[depth+match], ART_TAGLEAF(new));
+
+            *ref = parent;
+            ++art->cnt;
+            return true;
+        }
+
+        depth += node->plen;
+
+        if (depth == len) {
+            if (node->leaf) {
+                node->leaf->val = val;
+                return true;
+            }
+            node->leaf = art_leaf(mem, key, val);
+            if (!node->leaf) return false;
+            ++art->cnt;
+            return true;
+        }
+
+        void **child = art_child(node, k[depth]);
+
+        if (!child) {
+            ArtLeaf *new = art_leaf(mem, key, val);
+            if (!new) return false;
+            if (!art_add(mem, ref, k[depth], ART_TAGLEAF(new))) {
+                art_freenode(mem, ART_TAGLEAF(new));
+                return false;
+            }
+            ++art->cnt;
+            return true;
+        }
+
+        ref = child;
+        ++depth;
+    }
+
+    // empty tree
+    ArtLeaf *new = art_leaf(mem, key, val);
+    if (!new) return false;
+    *ref = ART_TAGLEAF(new);
+    ++art->cnt;
+    return true;
+}
+
+/**
+ * Find the value of a key.
+ * @param[in] art the tree
+ * @param[in] key the key
+ * @return the value, or NULL if absent
+ */
+void*
+bft_art_find (const BuffetArt *art, const Buffet *key)
+{
+    const Tag tag = TAG(key);
+    const char *k = getdata(key, tag);
+    const size_t len = getlen(key, tag);
+    void *p = art->root;
+    size_t depth = 0;
+
+    while (p) {
+        if (ART_ISLEAF(p)) {
+            const ArtLeaf *leaf = ART_LEAF(p);
+            const Buffet *lk = &leaf->key;
+            return (getlen(lk, TAG(lk)) == len
+                && !memcmp(getdata(lk, TAG(lk)), k, len)) ? leaf->val : NULL;
+        }
+
+        ArtNode *node = p;
+        if (node->plen > len-depth || memcmp(node->prefix, k+depth, node->plen))
+            return NULL;
+        depth += node->plen;
+
+        if (depth == len) return node->leaf ? node->leaf->val : NULL;
+
+        void **child = art_child(node, k[depth++]);
+        p = child ? *child : NULL;
+    }
+
+    return NULL;
+}
+
+/**
+ * Find the longest key that prefixes `key`.
+ * @param[in] art the tree
+ * @param[in] key the key
+ * @param[out] matchlen if not NULL, the matching key length
+ * @return the matching key value, or NULL if none
+ */
+void*
+bft_art_longest (const BuffetArt *art, const Buffet *key, size_t *matchlen)
+{
+    const Tag tag = TAG(key);
+    const char *k = getdata(key, tag);
+    const size_t len = getlen(key, tag);
+    const ArtLeaf *best = NULL;
+    void *p = art->root;
+    size_t depth = 0;
+
+    while (p) {
+        if (ART_ISLEAF(p)) {
+            const ArtLeaf *leaf = ART_LEAF(p);
+            const Buffet *lk = &leaf->key;
+            const size_t llen = getlen(lk, TAG(lk));
+            if (llen <= len && !memcmp(getdata(lk, TAG(lk)), k, llen)) best = leaf;
+            break;
+        }
+
+        ArtNode *node = p;
+        if (node->plen > len-depth || memcmp(node->prefix, k+depth, node->plen))
+            break;
+        depth += node->plen;
+
+        if (node->leaf) best = node->leaf;
+        if (depth == len) break;
+
+        void **child = art_child(node, k[depth++]);
+        p = child ? *child : NULL;
+    }
+
+    if (matchlen) *matchlen = best ? getlen(&best->key, TAG(&best->key)) : 0;
+    return best ? best->val : NULL;
+}
+
+// visit subtree `p` in key order, false once `fn` stops
+static bool
+art_each (const void *p, BuffetArtVisit fn, void *ctx, size_t *cnt)
+{
+    if (ART_ISLEAF(p)) {
+        const ArtLeaf *leaf = ART_LEAF(p);
+        ++*cnt;
+        return fn(&leaf->key, leaf->val, ctx);
+    }
+
+    const ArtNode *node = p;
+    if (node->leaf && !art_each(ART_TAGLEAF(node->leaf), fn, ctx, cnt))
+        return false;
+
+    switch (node->type) {
+        case NODE4:
+            for (int i = 0; i < node->cnt; ++i)
+                if (!art_each(((ArtNode4*)node)->child[i], fn, ctx, cnt))
+                    return false;
+            break;
+        case NODE16:
+            for (int i = 0; i < node->cnt; ++i)
+                if (!art_each(((ArtNode16*)node)->child[i], fn, ctx, cnt))
+                    return false;
+            break;
+        case NODE48: {
+            const ArtNode48 *n = (ArtNode48*)node;
+            for (int b = 0; b < 256; ++b)
+                if (n->index[b] && !art_each(n->child[n->index[b]-1], fn, ctx, cnt))
+                    return false;
+            break;
+        }
+        default: {
+            const ArtNode256 *n = (ArtNode256*)node;
+            for (int b = 0; b < 256; ++b)
+                if (n->child[b] && !art_each(n->child[b], fn, ctx, cnt))
+                    return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Visit the keys starting with `prefix`, in bft_cmp order.
+ * @param[in] art the tree
+ * @param[in] prefix the prefix, or NULL for all keys
+ * @param[in] fn the visitor, returning false to stop
+ * @param[in] ctx the visitor context
+ * @return the number of visited keys
+ */
+size_t
+bft_art_each (const BuffetArt *art, const Buffet *prefix,
+    BuffetArtVisit fn, void *ctx)
+{
+    const char *k = prefix ? getdata(prefix, TAG(prefix)) : NULL;
+    const size_t len = prefix ? getlen(prefix, TAG(prefix)) : 0;
+    void *p = art->root;
+    size_t depth = 0;
+    size_t cnt = 0;
+
+    // descend to the subtree of keys starting with `prefix`
+    while (p && depth < len) {
+        if (ART_ISLEAF(p)) {
+            const Buffet *lk = &ART_LEAF(p)->key;
+            if (getlen(lk, TAG(lk)) < len || memcmp(getdata(lk, TAG(lk)), k, len))
+                return 0;
+            break;
+        }
+
+        ArtNode *node = p;
+        const size_t n = node->plen < len-depth ? node->plen : len-depth;
+        if (memcmp(node->prefix, k+depth, n)) return 0;
+        depth += node->plen;
+        if (depth >= len) break;
+
+        void **child = art_child(node, k[depth++]);
+        p = child ? *child : NULL;
+    }
+
+    if (p) art_each(p, fn, ctx, &cnt);
+    return cnt;
+}
+
+/**
+ * Get the number of keys in a tree.
+ * @param[in] art the tree
+ */
+size_t
+bft_art_count (const BuffetArt *art) {
+    return art->cnt;
+}
+
+/**
+ * Discard a tree, releasing its keys.
+ * @param[in] art the tree
+ */
+void
+bft_art_free (BuffetArt *art)
+{
+    if (art->root) art_freenode(art->mem, art->root);
+    *art = (BuffetArt){0};
+}
+
+/**
+ * Set the allocator of stores and lists, for all threads.
+ * Each store is released by the allocator that created it,
+ * which must stay valid as long as the store lives.
+ * Set at startup, before creating Buffets in other threads.
+ *
+ * @param[in] mem the allocator, or NULL to restore malloc
+ */
+void
+bft_set_allocator (const BuffetAllocator *mem) {
+    global_allocator = mem ? mem : &sys_allocator;
+}
+
+/**
+ * Set the allocator of stores and lists, for the calling thread only.
+ * Takes precedence over the global allocator.
+ * @see bft_set_allocator
+ *
+ * @param[in] mem the allocator, or NULL to use the global one
+ * @return the previous thread allocator, or NULL
+ */
+const BuffetAllocator*
+bft_set_thread_allocator (const BuffetAllocator *mem) 
+{
+    const BuffetAllocator *prev = thread_allocator;
+    thread_allocator = mem;
+    return prev;
+}
+
+/**
+ * Get the allocator in effect for the calling thread.
+ */
+const BuffetAllocator*
+bft_get_allocator (void) {
+    return getmem();
+}
+
+/**
+ * Get the library counters, summed over all threads.
+ * Only counts in a build with `BUFFET_STATS` defined, zero otherwise.
+ */
+BuffetStats
+bft_stats_get (void)
+{
+    BuffetStats ret = {0};
+
+    #if BUFFET_STATS
+        pthread_mutex_lock(&stats_lock);
+        stats_add(&ret, &stats_retired);
+        for (const StatsSlot *slot = stats_slots; slot; slot = slot->next) {
+            stats_add(&ret, &slot->cnt);
+        }
+        pthread_mutex_unlock(&stats_lock);
+    #endif
+
+    return ret;
+}
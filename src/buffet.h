@@ -16,12 +16,32 @@ Copyright (C) 2022 - Francois Alcover <francois|at|alcover|dot|fr>
 #define BUFFET_STACK_MEM 1024
 #endif
 
+// Buffet size in bytes : 24 (default), 32 or 64 (hard values show 64-bit).
+// A wider Buffet embeds longer small strings (SSO), at the cost of memory
+// and cache footprint for every handle.
+#ifndef BUFFET_SIZE
+#define BUFFET_SIZE 24
+#endif
+
+#if BUFFET_SIZE != 24 && BUFFET_SIZE != 32 && BUFFET_SIZE != 64
+#error "BUFFET_SIZE must be 24, 32 or 64"
+#endif
+
+// Padding comes first so that the tag stays in the last byte,
+// shared by BuffetPtr.tag and BuffetSSO.tag.
+#if BUFFET_SIZE > 24
+#define BUFFET_PAD char pad[BUFFET_SIZE-sizeof(char*)-2*sizeof(size_t)];
+#else
+#define BUFFET_PAD
+#endif
+
 #define TAGBITS 2
 
 // tag=OWN : share of heap data
 // tag=SSV : small string view
 // tag=VUE : view of any data
 typedef struct {
+    BUFFET_PAD
     char*   data;
     size_t  len;
     size_t  off:8*sizeof(size_t)-TAGBITS, tag:TAGBITS;
@@ -40,15 +60,114 @@ typedef union Buffet {
     char fill[sizeof(BuffetPtr)];
 } Buffet;
 
-static_assert (sizeof(BuffetPtr) == sizeof(char*) + 2*sizeof(size_t), 
-    "BuffetPtr size");
+static_assert (sizeof(BuffetPtr) == (BUFFET_SIZE > 24 ? BUFFET_SIZE 
+    : sizeof(char*) + 2*sizeof(size_t)), "BuffetPtr size");
 static_assert (sizeof(Buffet) == sizeof(BuffetPtr), 
     "Buffet size");
+static_assert (sizeof(((BuffetSSO){0}).data) <= (1<<(8-TAGBITS)), 
+    "BuffetSSO length bits");
 
 #undef TAGBITS
+#undef BUFFET_PAD
 
 #define BUFFET_ZERO ((Buffet){.fill={0}})
-#define BUFFET_SSOMAX (sizeof(((BuffetSSO){0}).data)-1)
+#define BUFFET_SSOMAX (sizeof(((BuffetSSO*)0)->data)-1)
+
+// Compact 16 bytes variant, for large tables of short strings.
+// The tag lives in the low bits of `ptr.ptr`, shared with `sso.tag`
+// (little-endian). An SSO embeds up to 15 bytes and has no views : 
+// viewing it makes a copy. Length is limited to 4GB.
+// tag=OWN : ptr is the store, off is the share offset
+// tag=VUE : ptr is the data aligned down, off the remainder
+typedef union {
+    struct {
+        uintptr_t ptr;
+        uint32_t  len;
+        uint32_t  off;
+    } ptr;
+    struct {
+        uint8_t   tag:2, len:6;
+        char      data[15];
+    } sso;
+    char fill[16];
+} BuffetCompact;
+
+static_assert (sizeof(BuffetCompact) == 16, "BuffetCompact size");
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "BuffetCompact tag bits need a little-endian target"
+#endif
+
+#define BUFFET_COMPACT_ZERO ((BuffetCompact){.fill={0}})
+#define BUFFET_COMPACT_SSOMAX (sizeof(((BuffetCompact*)0)->sso.data))
+
+// Column of packed strings : one data blob and an offsets array.
+// String i spans data[offs[i] .. offs[i+1]].
+// Offsets are 32-bit unless built with `BUFFET_COLUMN_WIDE`.
+#if BUFFET_COLUMN_WIDE
+typedef uint64_t BuffetColumnOff;
+#else
+typedef uint32_t BuffetColumnOff;
+#endif
+
+typedef struct {
+    char   *data;
+    size_t  datalen;
+    size_t  datacap;
+    BuffetColumnOff *offs;
+    size_t  cnt;
+    size_t  offscap;
+    const struct BuffetAllocator *mem;
+} BuffetColumn;
+
+// Sorted strings dictionary, front-coded by blocks of BUFFET_DICT_BLOCK keys.
+// Each block starts with a full key, then each key stores the length 
+// it shares with the previous one and its remaining suffix.
+#define BUFFET_DICT_BLOCK 16
+
+typedef struct {
+    char   *data;
+    size_t  datalen;
+    size_t *blocks; // offset of each block in data
+    size_t  cnt;
+    size_t  maxlen; // longest key
+    const struct BuffetAllocator *mem;
+} BuffetDict;
+
+// Adaptive radix trie mapping Buffet keys to values, in key order.
+typedef struct {
+    void   *root;
+    size_t  cnt;
+    const struct BuffetAllocator *mem;
+} BuffetArt;
+
+// Visitor of bft_art_each(), returns false to stop
+typedef bool (*BuffetArtVisit) (const Buffet *key, void *val, void *ctx);
+
+// Custom memory functions for stores and lists.
+// `ctx` is passed back on each call. Sizes are those of the allocation.
+// Returned memory must be aligned for any type, as by malloc.
+// `realloc` is only called on a block from `alloc`, never with NULL.
+typedef struct BuffetAllocator {
+    void* (*alloc)   (size_t size, void *ctx);
+    void* (*realloc) (void *ptr, size_t oldsize, size_t newsize, void *ctx);
+    void  (*free)    (void *ptr, size_t size, void *ctx);
+    void*   ctx;
+} BuffetAllocator;
+
+// Library counters, enabled by building with `BUFFET_STATS`
+typedef struct {
+    uint64_t stores_new;      // stores allocated
+    uint64_t stores_freed;    // stores released
+    uint64_t bytes_live;      // current stores allocation
+    uint64_t reallocs;        // stores grown in place by realloc
+    uint64_t appends_inplace; // appends written into existing room
+    uint64_t detaches;        // shared views detached by append
+    uint64_t sso_promotions;  // SSO mutated into OWN by append or cat
+    uint64_t ssv_saturations; // views refused on an SSO at max refcount
+    uint64_t copies_shared;   // copies sharing their source store
+    uint64_t sso_demotions;   // short OWN turned back into SSO
+    uint64_t search_bytes;    // bytes inspected by separator search
+} BuffetStats;
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,20 +175,39 @@ extern "C" {
 
 Buffet  bft_new (size_t cap);
 Buffet  bft_memcopy (const char *src, size_t len);
+bool    bft_memcopy_many (const char *const *srcs, const size_t *lens, 
+                          int cnt, Buffet *out);
 Buffet  bft_memview (const char *src, size_t len);
 Buffet  bft_dup  (const Buffet *src);
 Buffet  bft_copy (const Buffet *src, size_t off, size_t len);
 Buffet  bft_copyall (const Buffet *src);
 Buffet  bft_view (Buffet *src, size_t off, size_t len);
+bool    bft_views (Buffet *src, const size_t *offs, const size_t *lens, 
+                   int cnt, Buffet *out);
 size_t  bft_cat (Buffet *dst, const Buffet *buf, const char *src, size_t len);
 size_t  bft_append (Buffet *buf, const char *src, size_t len);
+size_t  bft_insert (Buffet *buf, size_t off, const char *src, size_t len);
+size_t  bft_erase (Buffet *buf, size_t off, size_t len);
+size_t  bft_overwrite (Buffet *buf, size_t off, const char *src, size_t len);
+bool    bft_setbyte (Buffet *buf, size_t off, char c);
 void    bft_free (Buffet *buf);
 
+size_t  bft_retained (const Buffet *buf);
+bool    bft_compact (Buffet *buf, double ratio);
+int     bft_compact_many (Buffet *list, int cnt, double ratio);
+bool    bft_normalize (Buffet *buf);
+
 Buffet  bft_join (const Buffet *list, int cnt, 
                   const char* sep, size_t seplen);
+const char* 
+        bft_find (const char *src, size_t srclen, 
+                  const char *sep, size_t seplen);
 Buffet* bft_split (const char* src, size_t srclen,
                    const char* sep, size_t seplen, int *outcnt);
 Buffet* bft_splitstr (const char *src, const char *sep, int *outcnt);
+Buffet* bft_split_buf (Buffet *src, const char* sep, size_t seplen, 
+                       int *outcnt);
+void    bft_freelist (Buffet *list, int cnt);
 
 int     bft_cmp (const Buffet *a, const Buffet *b);
 size_t  bft_cap (const Buffet *buf);
@@ -81,6 +219,59 @@ const char*
         bft_cstr (const Buffet *buf, bool *mustfree);
 char*   bft_export (const Buffet *buf);
 
+BuffetCompact 
+        bftc_memcopy (const char *src, size_t len);
+BuffetCompact 
+        bftc_memview (const char *src, size_t len);
+BuffetCompact 
+        bftc_view (BuffetCompact *src, size_t off, size_t len);
+BuffetCompact 
+        bftc_dup (const BuffetCompact *src);
+void    bftc_free (BuffetCompact *buf);
+const char* 
+        bftc_data (const BuffetCompact *buf);
+size_t  bftc_len (const BuffetCompact *buf);
+size_t  bftc_retained (const BuffetCompact *buf);
+
+BuffetColumn 
+        bft_column_new (size_t cnt, size_t datalen);
+bool    bft_column_from (BuffetColumn *col, const Buffet *list, int cnt);
+bool    bft_column_append (BuffetColumn *col, const char *src, size_t len);
+Buffet  bft_column_get (const BuffetColumn *col, size_t i);
+size_t  bft_column_count (const BuffetColumn *col);
+Buffet* bft_column_views (const BuffetColumn *col, int *outcnt);
+void    bft_column_free (BuffetColumn *col);
+
+BuffetDict
+        bft_dict_from (const Buffet *sorted, int cnt);
+long    bft_dict_find (const BuffetDict *dict, const Buffet *key);
+long    bft_dict_prefix (const BuffetDict *dict, const Buffet *prefix, long *first);
+Buffet  bft_dict_get (const BuffetDict *dict, long i);
+size_t  bft_dict_count (const BuffetDict *dict);
+size_t  bft_dict_retained (const BuffetDict *dict);
+void    bft_dict_free (BuffetDict *dict);
+
+bool    bft_art_insert (BuffetArt *art, const Buffet *key, void *val);
+void*   bft_art_find (const BuffetArt *art, const Buffet *key);
+void*   bft_art_longest (const BuffetArt *art, const Buffet *key, size_t *matchlen);
+size_t  bft_art_each (const BuffetArt *art, const Buffet *prefix, 
+            BuffetArtVisit fn, void *ctx);
+size_t  bft_art_count (const BuffetArt *art);
+void    bft_art_free (BuffetArt *art);
+
+void    bft_set_allocator (const BuffetAllocator *mem);
+const BuffetAllocator*
+        bft_set_thread_allocator (const BuffetAllocator *mem);
+const BuffetAllocator* 
+        bft_get_allocator (void);
+
+BuffetStats 
+        bft_stats_get (void);
+
+bool    bft_set_isa (const char *isa);
+const char* 
+        bft_isa (void);
+
 void    bft_print (const Buffet *buf);
 void    bft_dbg (const Buffet *buf);
 
@@ -88,4 +279,59 @@ void    bft_dbg (const Buffet *buf);
 }
 #endif
 
+// Inline fast paths of the hot accessors, resolving the tag at the call site
+// so that the compiler can fold it when known. Slow cases call the library.
+// The functions stay exported : call them as `(bft_len)(buf)`, or build 
+// with `BUFFET_NO_INLINE` to disable the macros.
+// Tags : 0 SSO, 1 OWN, 2 SSV, 3 VUE
+#ifndef BUFFET_NO_INLINE
+
+static inline const char*
+bft_data_inline (const Buffet *buf) {
+    return buf->sso.tag ? buf->ptr.data : buf->sso.data;
+}
+
+static inline size_t
+bft_len_inline (const Buffet *buf) {
+    return buf->sso.tag ? buf->ptr.len : buf->sso.len;
+}
+
+// Views have no capacity. An OWN asks its store.
+static inline size_t
+bft_cap_inline (const Buffet *buf) {
+    return !buf->sso.tag ? BUFFET_SSOMAX 
+         : buf->sso.tag == 1 ? bft_cap(buf) : 0;
+}
+
+// An SSO is copied without its views count, a VUE as is.
+static inline Buffet
+bft_dup_inline (const Buffet *src)
+{
+    Buffet ret = *src;
+    switch (src->sso.tag) {
+        case 0: ret.sso.rfc = 0; return ret;
+        case 3: return ret;
+        default: return bft_dup(src);
+    }
+}
+
+// An SSO without views or a VUE only needs zeroing.
+static inline void
+bft_free_inline (Buffet *buf)
+{
+    if ((!buf->sso.tag && !buf->sso.rfc) || buf->sso.tag == 3) {
+        *buf = BUFFET_ZERO;
+    } else {
+        bft_free(buf);
+    }
+}
+
+#define bft_data(buf) bft_data_inline(buf)
+#define bft_len(buf)  bft_len_inline(buf)
+#define bft_cap(buf)  bft_cap_inline(buf)
+#define bft_dup(src)  bft_dup_inline(src)
+#define bft_free(buf) bft_free_inline(buf)
+
+#endif
+
 #endif //guard
\ No newline at end of file
@@ -0,0 +1,318 @@
+/*
+Buffet - All-inclusive Buffer for C
+Copyright (C) 2022 - Francois Alcover <francois|at|alcover|dot|fr>
+
+C++ wrapper : bft::Buffet owns a Buffet and releases it on destruction.
+*/
+
+#ifndef BUFFET_HPP
+#define BUFFET_HPP
+
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory_resource>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "buffet.h"
+
+namespace bft {
+
+class Buffet {
+
+public:
+
+    Buffet () noexcept : buf{} {}
+
+    // copy `len` bytes of `src`
+    Buffet (const char *src, size_t len) : buf(bft_memcopy(src, len)) {}
+    explicit Buffet (std::string_view src) : Buffet(src.data(), src.size()) {}
+
+    // take ownership of a C Buffet
+    static Buffet adopt (::Buffet raw) noexcept {
+        Buffet ret;
+        ret.buf = raw;
+        return ret;
+    }
+
+    // view of `src`, which must outlive it
+    static Buffet memview (const char *src, size_t len) noexcept {
+        return adopt(bft_memview(src, len));
+    }
+    static Buffet memview (std::string_view src) noexcept {
+        return memview(src.data(), src.size());
+    }
+
+    // shallow copy, as bft_dup
+    Buffet (const Buffet &other) noexcept : buf(bft_dup(&other.buf)) {}
+
+    // no refcount change
+    Buffet (Buffet &&other) noexcept {take(other);}
+
+    Buffet& operator= (const Buffet &other) noexcept
+    {
+        if (this != &other) {
+            ::Buffet tmp = bft_dup(&other.buf);
+            bft_free(&buf);
+            buf = tmp;
+        }
+        return *this;
+    }
+
+    Buffet& operator= (Buffet &&other) noexcept
+    {
+        if (this != &other) {
+            bft_free(&buf);
+            take(other);
+        }
+        return *this;
+    }
+
+    ~Buffet () {bft_free(&buf);}
+
+    // give back the C Buffet, leaving this one empty
+    ::Buffet release () noexcept {
+        ::Buffet ret = buf;
+        buf = ::Buffet{};
+        return ret;
+    }
+
+    ::Buffet* get () noexcept {return &buf;}
+    const ::Buffet* get () const noexcept {return &buf;}
+
+    // accessors, inline as getdata/getlen in buffet.c
+    const char* data () const noexcept {
+        return buf.sso.tag ? buf.ptr.data : buf.sso.data;
+    }
+    size_t size () const noexcept {
+        return buf.sso.tag ? buf.ptr.len : buf.sso.len;
+    }
+    bool empty () const noexcept {return !size();}
+    char operator[] (size_t i) const noexcept {return data()[i];}
+
+    operator std::string_view () const noexcept {
+        return std::string_view(data(), size());
+    }
+
+    Buffet view (size_t off, size_t len) {
+        return adopt(bft_view(&buf, off, len));
+    }
+    Buffet copy (size_t off, size_t len) const {
+        return adopt(bft_copy(&buf, off, len));
+    }
+
+    size_t append (const char *src, size_t len) {
+        return bft_append(&buf, src, len);
+    }
+    size_t append (std::string_view src) {
+        return bft_append(&buf, src.data(), src.size());
+    }
+    Buffet& operator+= (std::string_view src) {
+        append(src);
+        return *this;
+    }
+
+    friend bool operator== (const Buffet &a, const Buffet &b) noexcept {
+        return std::string_view(a) == std::string_view(b);
+    }
+    friend std::strong_ordering operator<=> (const Buffet &a, const Buffet &b) noexcept {
+        return std::string_view(a) <=> std::string_view(b);
+    }
+    friend bool operator== (const Buffet &a, std::string_view b) noexcept {
+        return std::string_view(a) == b;
+    }
+    friend std::strong_ordering operator<=> (const Buffet &a, std::string_view b) noexcept {
+        return std::string_view(a) <=> b;
+    }
+
+private:
+
+    ::Buffet buf;
+
+    // An SSO with views can't move, as they point into it : it is dup'ed.
+    void take (Buffet &other) noexcept
+    {
+        if (!other.buf.sso.tag && other.buf.sso.rfc) {
+            buf = bft_dup(&other.buf);
+        } else {
+            buf = other.buf;
+            other.buf = ::Buffet{};
+        }
+    }
+};
+
+//=============================================================================
+
+// Lazy bft_split : the parts of `src` between occurrences of `sep`, found on
+// iteration. Parts are string_views into `src`, which must outlive them.
+// As bft_split, an empty separator yields `src` whole.
+class split_view : public std::ranges::view_interface<split_view> {
+
+public:
+
+    class iterator {
+
+    public:
+
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator () noexcept = default;
+
+        std::string_view operator* () const noexcept {
+            return src.substr(beg, end-beg);
+        }
+
+        iterator& operator++ () noexcept
+        {
+            if (end == src.size()) {
+                beg = std::string_view::npos;
+            } else {
+                beg = end + sep.size();
+                end = next(beg);
+            }
+            return *this;
+        }
+
+        iterator operator++ (int) noexcept {
+            iterator ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        bool operator== (const iterator &other) const noexcept {
+            return beg == other.beg;
+        }
+        bool operator== (std::default_sentinel_t) const noexcept {
+            return beg == std::string_view::npos;
+        }
+
+    private:
+
+        friend class split_view;
+
+        std::string_view src, sep;
+        size_t beg = std::string_view::npos;
+        size_t end = 0;
+
+        iterator (std::string_view src, std::string_view sep) noexcept
+        : src(src), sep(sep), beg(0), end(next(0)) {}
+
+        size_t next (size_t from) const noexcept
+        {
+            // not string_view::find, quadratic on partial matches
+            const char *pos = bft_find(src.data()+from, src.size()-from, 
+                sep.data(), sep.size());
+            return pos ? pos - src.data() : src.size();
+        }
+    };
+
+    split_view () noexcept = default;
+    split_view (std::string_view src, std::string_view sep) noexcept
+    : src(src), sep(sep) {}
+
+    // a temporary owning string (Buffet, std::string...) would leave the 
+    // parts dangling. Views and pointers are borrowed, so accepted.
+    template <class T>
+    requires (!std::is_lvalue_reference_v<T>
+        && !std::is_pointer_v<std::decay_t<T>>
+        && !std::same_as<std::remove_cvref_t<T>, std::string_view>
+        && std::convertible_to<T, std::string_view>)
+    split_view (T&&, std::string_view) = delete;
+
+    iterator begin () const noexcept {return iterator(src, sep);}
+    std::default_sentinel_t end () const noexcept {return {};}
+
+private:
+
+    std::string_view src, sep;
+};
+
+//=============================================================================
+
+// Buffet allocator drawing from a std::pmr::memory_resource.
+// Like the resource, it must outlive the stores it allocates.
+class PmrAllocator {
+
+public:
+
+    explicit PmrAllocator (std::pmr::memory_resource *res) noexcept
+    : mem{alloc, realloc, free, res} {}
+
+    PmrAllocator (const PmrAllocator&) = delete;
+    PmrAllocator& operator= (const PmrAllocator&) = delete;
+
+    const BuffetAllocator* get () const noexcept {return &mem;}
+
+private:
+
+    BuffetAllocator mem;
+
+    static constexpr size_t align = alignof(std::max_align_t);
+
+    static void* alloc (size_t size, void *ctx) noexcept
+    {
+        try {
+            return static_cast<std::pmr::memory_resource*>(ctx)->allocate(size, align);
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    static void* realloc (void *ptr, size_t oldsize, size_t newsize, void *ctx) noexcept
+    {
+        void *ret = alloc(newsize, ctx);
+        if (ret && ptr) {
+            std::memcpy(ret, ptr, oldsize < newsize ? oldsize : newsize);
+            free(ptr, oldsize, ctx);
+        }
+        return ret;
+    }
+
+    static void free (void *ptr, size_t size, void *ctx) noexcept {
+        static_cast<std::pmr::memory_resource*>(ctx)->deallocate(ptr, size, align);
+    }
+};
+
+// Route the calling thread's Buffet allocations to `mem` within a scope.
+class AllocatorScope {
+
+public:
+
+    explicit AllocatorScope (const BuffetAllocator *mem) noexcept
+    : prev(bft_set_thread_allocator(mem)) {}
+
+    explicit AllocatorScope (const PmrAllocator &mem) noexcept
+    : AllocatorScope(mem.get()) {}
+
+    AllocatorScope (const AllocatorScope&) = delete;
+    AllocatorScope& operator= (const AllocatorScope&) = delete;
+
+    ~AllocatorScope () {bft_set_thread_allocator(prev);}
+
+private:
+
+    const BuffetAllocator *prev;
+};
+
+} // namespace bft
+
+// parts point into the source, not the view
+template<>
+inline constexpr bool std::ranges::enable_borrowed_range<bft::split_view> = true;
+
+template<>
+struct std::hash<bft::Buffet> {
+    size_t operator() (const bft::Buffet &buf) const noexcept {
+        return std::hash<std::string_view>{}(buf);
+    }
+};
+
+#endif
@@ -2,15 +2,18 @@
 #undef NDEBUG
 #endif
 
+#define _POSIX_C_SOURCE 199309L // clock_gettime
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
 #include "buffet.h"
 #include "log.h"
 #include "util.h"
 
 
+#define TAG(buf) ((buf)->sso.tag)
 #define alphalen (128)
 char alpha[alphalen+1];
 char tmp[alphalen+1];
@@ -111,6 +114,40 @@ void memcopy()
     serie(umemcopy, 8);
 }
 
+//=============================================================================
+void memcopy_many()
+{
+    const size_t lens[] = {0, 8, BUFFET_SSOMAX, BUFFET_SSOMAX+1, 1, 64, 32};
+    const int cnt = sizeof(lens)/sizeof(*lens);
+    const char *srcs[cnt];
+    Buffet out[cnt];
+
+    for (int i = 0; i < cnt; ++i) srcs[i] = alpha+i;
+
+    assert (bft_memcopy_many(srcs, lens, cnt, out));
+
+    size_t retained = 0;
+    for (int i = 0; i < cnt; ++i) {
+        check_props(&out[i], i, lens[i]);
+        if (lens[i] > BUFFET_SSOMAX) {
+            if (retained) assert_int (bft_retained(&out[i]), retained);
+            retained = bft_retained(&out[i]);
+        } else {
+            assert_int (bft_retained(&out[i]), 0);
+        }
+    }
+
+    // store outlives any co-owner
+    bft_free(&out[5]);
+    check_props(&out[3], 3, lens[3]);
+    check_props(&out[6], 6, lens[6]);
+    for (int i = 0; i < cnt; ++i) bft_free(&out[i]);
+
+    // all SSO
+    assert (bft_memcopy_many(srcs, lens, 3, out));
+    for (int i = 0; i < 3; ++i) check_props(&out[i], i, lens[i]);
+}
+
 //=============================================================================
 void umemview (size_t off, size_t len) {
     Buffet buf = bft_memview (alpha+off, len);
@@ -177,6 +214,40 @@ void dup()
 }
 
 
+//=============================================================================
+// inline accessors agree with the library functions
+void inlined()
+{
+    Buffet sso = bft_memcopy(alpha, 8);
+    Buffet own = bft_memcopy(alpha, alphalen);
+    Buffet ssv = bft_view(&sso, 1, 4);
+    Buffet vue = bft_memview(alpha, alphalen);
+    Buffet *all[] = {&sso, &own, &ssv, &vue};
+
+    for (int i = 0; i < 4; ++i) {
+        Buffet *buf = all[i];
+        assert_int (TAG(buf), i);
+        assert (bft_data(buf) == (bft_data)(buf));
+        assert_int (bft_len(buf), (bft_len)(buf));
+        assert_int (bft_cap(buf), (bft_cap)(buf));
+
+        Buffet a = bft_dup(buf);
+        Buffet b = (bft_dup)(buf);
+        assert (!memcmp(&a, &b, sizeof(Buffet)));
+        bft_free(&a);
+        (bft_free)(&b);
+        check_zero(&a);
+        check_zero(&b);
+    }
+
+    assert_int (sso.sso.rfc, 1);
+    bft_free(&ssv);
+    bft_free(&vue);
+    bft_free(&own);
+    bft_free(&sso);
+    check_zero(&sso);
+}
+
 //=============================================================================
 void ucopy (size_t off, size_t len) {
     Buffet src = bft_memcopy(alpha, alphalen);
@@ -186,11 +257,65 @@ void ucopy (size_t off, size_t len) {
     bft_free(&src);
 }
 
+// copies of an OWN share its store until mutated
+void copy_cow (size_t len) 
+{
+    Buffet src = bft_memcopy(alpha, len);
+    Buffet cpy = bft_copyall(&src);
+    Buffet sub = bft_copy(&src, 1, len-2);
+    Buffet sso = bft_copy(&src, 0, BUFFET_SSOMAX);
+    assert (bft_data(&cpy) == bft_data(&src));
+    assert (bft_data(&sub) == bft_data(&src)+1);
+    assert_int (TAG(&sso), 0);
+
+    // mutating the copy detaches it
+    bft_append(&cpy, "!", 1);
+    assert (bft_data(&cpy) != bft_data(&src));
+    check_props(&src, 0, len);
+    assert_stn (bft_data(&cpy), alpha, len);
+    assert_str (bft_data(&cpy)+len, "!");
+
+    // mutating the source leaves the copy
+    bft_append(&src, "?", 1);
+    check_props(&sub, 1, len-2);
+
+    // the copy outlives its source
+    bft_free(&src);
+    check_props(&sub, 1, len-2);
+    check_props(&sso, 0, BUFFET_SSOMAX);
+    bft_free(&sub);
+    bft_free(&cpy);
+}
+
+// a small range of a big store is copied, not shared
+void copy_small_range() 
+{
+    const size_t len = alphalen-1;
+    Buffet big = bft_new(2*len);
+    Buffet full = bft_new(len);
+    bft_append(&big, alpha, len);
+    bft_append(&full, alpha, len);
+    Buffet cpy = bft_copyall(&full);
+    Buffet sub = bft_copy(&big, 1, len-2);
+    assert (bft_data(&cpy) == bft_data(&full));
+    assert (bft_data(&sub) != bft_data(&big)+1);
+    assert (bft_retained(&sub) < bft_retained(&big));
+    bft_free(&big);
+    bft_free(&full);
+    check_props(&cpy, 0, len);
+    check_props(&sub, 1, len-2);
+    bft_free(&cpy);
+    bft_free(&sub);
+}
+
 void copy() 
 {
     serie(ucopy, 0);
     serie(ucopy, 8);
     ucopy (0, alphalen);
+    copy_cow(BUFFET_SSOMAX+3);
+    copy_cow(alphalen-1);
+    copy_small_range();
 }
 
 
@@ -280,6 +405,76 @@ void view()
 
 //==============================================================================
 
+#define VIEWS_CNT 6
+
+// compare bft_views to bft_view on each range
+void uviews (Buffet *src, size_t srclen) 
+{
+    const size_t offs[VIEWS_CNT] = {0, 0, 2, 2, srclen, 1};
+    const size_t lens[VIEWS_CNT] = {0, srclen, srclen/2, srclen, 1, 3};
+    Buffet views[VIEWS_CNT];
+
+    assert (bft_views(src, offs, lens, VIEWS_CNT, views));
+
+    for (int i = 0; i < VIEWS_CNT; ++i) {
+        Buffet one = bft_view(src, offs[i], lens[i]);
+        assert_int (bft_len(&views[i]), bft_len(&one));
+        assert_int (TAG(&views[i]), TAG(&one));
+        assert (bft_data(&views[i]) == bft_data(&one) || !bft_len(&one));
+        bft_free(&one);
+    }
+
+    for (int i = 0; i < VIEWS_CNT; ++i) bft_free(&views[i]);
+}
+
+#define views_init(op, srclen) { \
+    Buffet src = bft_##op(alpha, srclen); \
+    uviews(&src, srclen); \
+    bft_free(&src); check_zero(&src); \
+}
+
+void views()
+{
+    views_init (memcopy, 0);
+    views_init (memcopy, 8);
+    views_init (memcopy, BUFFET_SSOMAX);
+    views_init (memcopy, 64);
+    views_init (memview, 8);
+    views_init (memview, 64);
+
+    // on SSV
+    Buffet sso = bft_memcopy(alpha, 8);
+    Buffet ssv = bft_view(&sso, 1, 6);
+    uviews(&ssv, 6);
+    bft_free(&ssv); check_zero(&ssv);
+    bft_free(&sso); check_zero(&sso);
+
+    // views outlive OWN source
+    Buffet own = bft_memcopy(alpha, 64);
+    Buffet own_views[2];
+    assert (bft_views(&own, (size_t[]){0,32}, (size_t[]){32,32}, 2, own_views));
+    bft_free(&own); check_zero(&own);
+    check_props(&own_views[0], 0, 32);
+    check_props(&own_views[1], 32, 32);
+    bft_free(&own_views[0]);
+    bft_free(&own_views[1]);
+
+    // SSO views saturation
+    enum {many = 200};
+    size_t offs[many] = {0};
+    size_t lens[many];
+    for (int i = 0; i < many; ++i) lens[i] = 4;
+    Buffet list[2][many];
+    sso = bft_memcopy(alpha, 8);
+    assert (bft_views(&sso, offs, lens, many, list[0]));
+    assert (!bft_views(&sso, offs, lens, many, list[1]));
+    check_zero(&list[1][0]);
+    for (int i = 0; i < many; ++i) bft_free(&list[0][i]);
+    bft_free(&sso); check_zero(&sso);
+}
+
+//==============================================================================
+
 #define ucat(dst, buf, buflen, len) {\
     size_t rc = bft_cat(dst, buf, alpha+buflen, len); \
     size_t explen = buflen+len; \
@@ -462,7 +657,7 @@ void append()
     apn_to_view (32, 32);
 
     apn_viewed (8, 4, 12);
-    apn_viewed (8, 32, 0); // would mutate
+    apn_viewed (8, BUFFET_SSOMAX, 0); // would mutate
     apn_viewed (BUFFET_SSOMAX+1, 32, (BUFFET_SSOMAX+1+32));
 
     #if MEMCHECK
@@ -505,6 +700,154 @@ void append()
     usploin (#sep #sep #a #sep #sep #b,  #sep);  \
     usploin (#sep #sep #a #sep #sep #b #sep #sep, #sep); 
 
+//=============================================================================
+// Check `buf` holds `exp` after each edit
+#define assert_edit(buf, exp) { \
+    assert_int (bft_len(buf), strlen(exp)); \
+    assert_str (bft_data(buf), exp); \
+}
+
+// in place edits on `buf`, for all modes
+void uedit (Buffet buf, size_t len)
+{
+    char exp[256];
+    memcpy(exp, alpha, len);
+    exp[len] = 0;
+
+    bft_insert(&buf, 2, "++", 2);
+    memmove(exp+4, exp+2, len-1);
+    memcpy(exp+2, "++", 2);
+    assert_edit(&buf, exp);
+
+    bft_erase(&buf, 0, 3);
+    memmove(exp, exp+3, strlen(exp)-2);
+    assert_edit(&buf, exp);
+
+    bft_setbyte(&buf, 0, '#');
+    exp[0] = '#';
+    assert_edit(&buf, exp);
+
+    // overwrite past the end extends
+    size_t curlen = strlen(exp);
+    bft_overwrite(&buf, curlen-1, "END", 3);
+    strcpy(exp+curlen-1, "END");
+    assert_edit(&buf, exp);
+
+    // erase clips to the end
+    bft_erase(&buf, 1, 1000);
+    exp[1] = 0;
+    assert_edit(&buf, exp);
+
+    bft_free(&buf);
+}
+
+void edit()
+{
+    const size_t L = BUFFET_SSOMAX;
+
+    uedit(bft_memcopy(alpha, 8), 8);
+    uedit(bft_memcopy(alpha, L), L);
+    uedit(bft_memcopy(alpha, L+4), L+4);
+    uedit(bft_memcopy(alpha, 100), 100);
+    uedit(bft_memview(alpha, 8), 8);
+    uedit(bft_memview(alpha, 100), 100);
+    assert_stn (alpha, ALPHA64, 8); // views detached
+
+    // unique owner edits in place
+    Buffet own = bft_memcopy(alpha, 100);
+    const char *data = bft_data(&own);
+    assert (bft_setbyte(&own, 99, '!'));
+    bft_erase(&own, 10, 10);
+    bft_insert(&own, 10, alpha+10, 10);
+    assert (bft_data(&own) == data);
+    assert_stn (bft_data(&own), alpha, 99);
+    assert_str (bft_data(&own)+99, "!");
+
+    // shared owner detaches, co-owners keep their data
+    Buffet cpy = bft_copyall(&own);
+    Buffet ref = bft_view(&own, 0, 50);
+    assert (bft_setbyte(&cpy, 0, '#'));
+    assert (bft_data(&cpy) != data);
+    assert_stn (bft_data(&cpy)+1, bft_data(&own)+1, 99);
+    check_props(&ref, 0, 50);
+    assert (bft_setbyte(&ref, 0, '#'));
+    assert (bft_data(&own)[0] == alpha[0]);
+    bft_free(&cpy);
+    bft_free(&ref);
+
+    // source within the Buffet
+    bft_insert(&own, 0, bft_data(&own)+1, 3);
+    assert_stn (bft_data(&own), alpha+1, 3);
+    assert_stn (bft_data(&own)+3, alpha, 4);
+    bft_free(&own);
+
+    // views on SSO : edits in the SSO are refused, views detach
+    Buffet sso = bft_memcopy(alpha, 8);
+    Buffet ssv = bft_view(&sso, 2, 4);
+    assert_int (bft_insert(&sso, 0, "+", 1), 0);
+    assert_int (bft_setbyte(&sso, 0, '+'), false);
+    check_props(&sso, 0, 8);
+    assert (bft_setbyte(&ssv, 0, '+'));
+    assert_stn (bft_data(&ssv), "+", 1);
+    assert_stn (bft_data(&ssv)+1, alpha+3, 3);
+    check_props(&sso, 0, 8);
+    bft_free(&ssv);
+    assert (bft_setbyte(&sso, 0, '+'));
+    assert_stn (bft_data(&sso), "+", 1);
+    assert_stn (bft_data(&sso)+1, alpha+1, 7);
+
+    // out of range
+    assert_int (bft_insert(&sso, 9, "+", 1), 0);
+    assert_int (bft_setbyte(&sso, 8, '+'), false);
+    assert_int (bft_erase(&sso, 8, 1), 8);
+    assert_stn (bft_data(&sso), "+", 1);
+    assert_stn (bft_data(&sso)+1, alpha+1, 7);
+    bft_free(&sso);
+}
+
+// short unique owners go back to SSO
+void normalize()
+{
+    const size_t L = BUFFET_SSOMAX;
+
+    // by edits
+    Buffet own = bft_memcopy(alpha, 100);
+    Buffet ref = bft_view(&own, 0, 100);
+    bft_erase(&own, 0, 100-L); // shared : detaches
+    assert_int (TAG(&own), 0);
+    check_props(&own, 100-L, L);
+    bft_free(&own);
+    bft_erase(&ref, 4, 100-L); // unique : demotes
+    assert_int (TAG(&ref), 0);
+    assert_int (bft_len(&ref), L);
+    assert_stn (bft_data(&ref), alpha, 4);
+    bft_free(&ref);
+
+    // explicitly
+    own = bft_memcopy(alpha, 100);
+    ref = bft_view(&own, 2, 10);
+    Buffet big = bft_view(&own, 2, L+1);
+    bft_free(&own);
+    assert (!bft_normalize(&big));
+    assert (bft_normalize(&ref));
+    assert_int (TAG(&ref), 0);
+    check_props(&ref, 2, 10);
+    assert (!bft_normalize(&ref));
+    bft_free(&ref);
+    check_props(&big, 2, L+1);
+    bft_free(&big);
+
+    // by cat
+    own = bft_memcopy(alpha, 100);
+    ref = bft_view(&own, 0, 4);
+    Buffet dst;
+    bft_cat(&dst, &ref, alpha+4, 4);
+    assert_int (TAG(&dst), 0);
+    check_props(&dst, 0, 8);
+    bft_free(&ref);
+    bft_free(&own);
+}
+
 void splitjoin() 
 { 
     sploin (a, b, |)
@@ -513,6 +856,66 @@ void splitjoin()
     sploin (foo, bar, ||)
 }
 
+// split within bounds only
+void split_bounded()
+{
+    const char src[] = "a|b|c";
+    int cnt;
+    Buffet *parts = bft_split(src, 3, "|", 1, &cnt);
+    assert_int (cnt, 2);
+    assert_int (bft_len(&parts[1]), 1);
+    free(parts);
+
+    // empty separator
+    parts = bft_split(src, 5, "", 0, &cnt);
+    assert_int (cnt, 1);
+    assert_int (bft_len(&parts[0]), 5);
+    free(parts);
+}
+
+// split `srclen` bytes of alpha on the char at `step`.
+// Parts must match and outlive the source.
+void usplitbuf (Buffet src, size_t srclen, size_t step) 
+{
+    char sep[2] = {0};
+    sep[0] = alpha[step];
+    int cnt;
+    Buffet *parts = bft_split_buf(&src, sep, 1, &cnt);
+    int expcnt = (srclen > step) ? 2 : 1;
+    assert_int (cnt, expcnt);
+
+    bft_free(&src);
+    check_zero(&src);
+
+    check_props(&parts[0], 0, step < srclen ? step : srclen);
+    if (expcnt > 1) check_props(&parts[1], step+1, srclen-step-1);
+    
+    bft_freelist(parts, cnt);
+}
+
+void splitbuf()
+{
+    const size_t L = BUFFET_SSOMAX;
+    
+    usplitbuf (bft_memcopy(alpha, 8), 8, 4);
+    usplitbuf (bft_memcopy(alpha, 8), 8, 16);
+    // alpha repeats every 64 bytes : no second separator
+    usplitbuf (bft_memcopy(alpha, 64), 64, 4);
+    usplitbuf (bft_memcopy(alpha, 64), 64, L+2);
+    usplitbuf (bft_memcopy(alpha, 64), 64, 0);
+    usplitbuf (bft_memview(alpha, 64), 64, L+2);
+
+    // on views
+    Buffet own = bft_memcopy(alpha, 64);
+    usplitbuf (bft_view(&own, 0, 48), 48, 40);
+    bft_free(&own);
+
+    Buffet sso = bft_memcopy(alpha, 8);
+    usplitbuf (bft_view(&sso, 0, 6), 6, 2);
+    bft_free(&sso);
+    check_zero(&sso);
+}
+
 //=============================================================================
 
 #define check_free(buf) {\
@@ -563,7 +966,7 @@ void splitjoin()
     check_free(&alias); \
 }
 #define free_ref_alias(reflen) { \
-    Buffet own = bft_memcopy(alpha, 32); \
+    Buffet own = bft_memcopy(alpha, 64); \
     Buffet ref = bft_view (&own, 0, reflen); \
     Buffet alias = ref; \
     check_free(&ref); \
@@ -616,7 +1019,7 @@ void free_()
     
     free_viewed (0, true)
     free_viewed (8, true)
-    free_viewed (32, false)
+    free_viewed (BUFFET_SSOMAX+1, false)
 
     free_ref_alias (0)
     free_ref_alias (8)
@@ -674,6 +1077,466 @@ void cmp()
 }
 
 //=============================================================================
+
+#define ucompact(srclen, off, len, ratio, exp) { \
+    Buffet src = bft_memcopy(alpha, srclen); \
+    Buffet ref = bft_view(&src, off, len); \
+    size_t retained = bft_retained(&ref); \
+    assert_int (bft_compact(&ref, ratio), exp); \
+    check_props(&ref, off, len); \
+    if (exp) assert(bft_retained(&ref) < retained); \
+    else assert_int(bft_retained(&ref), retained); \
+    bft_free(&src); \
+    check_props(&ref, off, len); \
+    bft_free(&ref); \
+}
+
+void compact()
+{
+    // retained
+    Buffet sso = bft_memcopy(alpha, 8);
+    Buffet vue = bft_memview(alpha, 64);
+    Buffet own = bft_memcopy(alpha, 64);
+    assert_int (bft_retained(&sso), 0);
+    assert_int (bft_retained(&vue), 0);
+    assert (bft_retained(&own) > 64);
+    assert (!bft_compact(&sso, 1));
+    assert (!bft_compact(&vue, 1));
+    bft_free(&own);
+
+    ucompact (128, 0, 8, 0.5, true);  // to SSO
+    ucompact (128, 8, 32, 0.5, true); // to exact store
+    ucompact (128, 8, 32, 0.1, false);
+    ucompact (128, 0, 128, 0.5, false);
+
+    // many
+    Buffet src = bft_memcopy(alpha, alphalen);
+    Buffet list[4] = {
+        bft_view(&src, 0, 4),
+        bft_view(&src, 4, 32),
+        bft_view(&src, 0, alphalen),
+        bft_memcopy(alpha, 8)
+    };
+    assert_int (bft_compact_many(list, 4, 0.5), 2);
+    bft_free(&src);
+    check_props(&list[0], 0, 4);
+    check_props(&list[1], 4, 32);
+    check_props(&list[2], 0, alphalen);
+    check_props(&list[3], 0, 8);
+    for (int i = 0; i < 4; ++i) bft_free(&list[i]);
+}
+
+//=============================================================================
+
+#define delta(field) (int)(after.field - before.field)
+
+void stats()
+{
+    #if BUFFET_STATS
+    BuffetStats before = bft_stats_get();
+
+    const size_t L = BUFFET_SSOMAX+1;
+    Buffet own = bft_memcopy(alpha, 2*L);
+    Buffet ref = bft_view(&own, 0, L);
+    bft_append(&ref, alpha, 8); // detach
+    bft_append(&ref, alpha, 8); // in place
+    Buffet sso = bft_memcopy(alpha, 8);
+    bft_append(&sso, alpha, L); // promotion
+    bft_append(&sso, alpha, 2*L); // realloc
+
+    BuffetStats after = bft_stats_get();
+    assert_int (delta(stores_new), 3);
+    assert_int (delta(stores_freed), 0);
+    assert_int (delta(detaches), 1);
+    assert_int (delta(appends_inplace), 1);
+    assert_int (delta(sso_promotions), 1);
+    assert_int (delta(reallocs), 1);
+    assert (delta(bytes_live) > (int)(4*L));
+    
+    bft_free(&own);
+    bft_free(&ref);
+    bft_free(&sso);
+
+    after = bft_stats_get();
+    assert_int (delta(stores_freed), 3);
+    assert_int (delta(bytes_live), 0);
+    #endif
+}
+
+#undef delta
+
+//=============================================================================
+
+typedef struct {
+    int allocs;
+    int frees;
+    size_t live;
+} MemCount;
+
+static void* cnt_alloc (size_t size, void *ctx) {
+    MemCount *cnt = ctx;
+    ++ cnt->allocs;
+    cnt->live += size;
+    return malloc(size);
+}
+
+static void* cnt_realloc (void *ptr, size_t oldsize, size_t newsize, void *ctx) {
+    assert (ptr); // never NULL, by the BuffetAllocator contract
+    MemCount *cnt = ctx;
+    cnt->live += newsize - oldsize;
+    return realloc(ptr, newsize);
+}
+
+static void cnt_free (void *ptr, size_t size, void *ctx) {
+    MemCount *cnt = ctx;
+    ++ cnt->frees;
+    cnt->live -= size;
+    free(ptr);
+}
+
+void allocator()
+{
+    MemCount cnt = {0};
+    const BuffetAllocator mem = {cnt_alloc, cnt_realloc, cnt_free, &cnt};
+
+    bft_set_thread_allocator(&mem);
+    assert (bft_get_allocator() == &mem);
+
+    Buffet sso = bft_memcopy(alpha, 8);
+    assert_int (cnt.allocs, 0);
+    Buffet own = bft_memcopy(alpha, BUFFET_SSOMAX+1);
+    assert_int (cnt.allocs, 1);
+    bft_append(&own, alpha, 64); // realloc
+    bft_append(&sso, alpha, BUFFET_SSOMAX); // promote
+
+    // split beyond the stack list, and join
+    char src[3*alphalen+1];
+    repeatat(src, sizeof(src)-1, "a ");
+    int n;
+    Buffet *parts = bft_splitstr(src, " ", &n);
+    assert_int (n, sizeof(src)/2 + 1);
+    Buffet joined = bft_join(parts, n, " ", 1);
+    assert_str (bft_data(&joined), src);
+
+    // stores and lists outlive a change of allocator
+    bft_set_thread_allocator(NULL);
+    assert (bft_get_allocator() != &mem);
+
+    bft_free(&sso);
+    bft_free(&own);
+    bft_free(&joined);
+    bft_freelist(parts, n);
+
+    assert_int (cnt.allocs, cnt.frees);
+    assert_int (cnt.live, 0);
+}
+
+//=============================================================================
+
+#define check_compact(buf, off, len) { \
+    assert_int (bftc_len(buf), len); \
+    assert_stn (bftc_data(buf), alpha+(off), len); \
+}
+
+void ucompact16 (size_t off, size_t len) 
+{
+    BuffetCompact own = bftc_memcopy(alpha+off, len);
+    check_compact(&own, off, len);
+    assert_int (!!bftc_retained(&own), len > BUFFET_COMPACT_SSOMAX);
+
+    BuffetCompact vue = bftc_memview(alpha+off, len);
+    check_compact(&vue, off, len);
+
+    // view of view, dup
+    BuffetCompact ref = bftc_view(&own, 1, len);
+    BuffetCompact sub = bftc_view(&vue, 1, len);
+    BuffetCompact cpy = bftc_dup(&ref);
+    size_t sublen = len ? len-1 : 0;
+    check_compact(&ref, off+1, sublen);
+    check_compact(&sub, off+1, sublen);
+    check_compact(&cpy, off+1, sublen);
+
+    // views survive their source
+    bftc_free(&own);
+    bftc_free(&vue);
+    check_compact(&own, 0, 0);
+    check_compact(&ref, off+1, sublen);
+    check_compact(&cpy, off+1, sublen);
+    bftc_free(&ref);
+    check_compact(&cpy, off+1, sublen);
+    bftc_free(&cpy);
+    bftc_free(&sub);
+    bftc_free(&sub);
+}
+
+void compact16()
+{
+    BuffetCompact zero = BUFFET_COMPACT_ZERO;
+    check_compact(&zero, 0, 0);
+    assert_int (BUFFET_COMPACT_SSOMAX, 15);
+
+    serie(ucompact16, 0);
+    serie(ucompact16, 1);
+    serie(ucompact16, 3);
+    ucompact16(0, BUFFET_COMPACT_SSOMAX);
+    ucompact16(1, BUFFET_COMPACT_SSOMAX+1);
+}
+
+//=============================================================================
+void column()
+{
+    enum {N = 40};
+    BuffetColumn col = bft_column_new(0, 0);
+    assert_int (bft_column_count(&col), 0);
+
+    // string i is alpha[i .. 2i]
+    for (int i = 0; i < N; ++i) 
+        assert (bft_column_append(&col, alpha+i, i));
+    assert_int (bft_column_count(&col), N);
+    assert_int (col.datalen, N*(N-1)/2);
+
+    for (int i = 0; i < N; ++i) {
+        Buffet vue = bft_column_get(&col, i);
+        check_props(&vue, i, i);
+        bft_free(&vue);
+    }
+    Buffet out = bft_column_get(&col, N);
+    check_zero(&out);
+
+    // to and from Buffet arrays
+    int cnt;
+    Buffet *list = bft_column_views(&col, &cnt);
+    assert_int (cnt, N);
+    BuffetColumn cpy;
+    assert (bft_column_from(&cpy, list, cnt));
+    bft_freelist(list, cnt);
+    bft_column_free(&col);
+    check_zero(&out);
+    assert (!col.data && !col.cnt);
+
+    assert_int (bft_column_count(&cpy), N);
+    assert_int (cpy.datacap, cpy.datalen);
+    for (int i = 0; i < N; ++i) {
+        Buffet vue = bft_column_get(&cpy, i);
+        check_props(&vue, i, i);
+    }
+    bft_column_free(&cpy);
+
+    // zeroed column is usable, with an allocator to the contract
+    MemCount memcnt = {0};
+    const BuffetAllocator mem = {cnt_alloc, cnt_realloc, cnt_free, &memcnt};
+    bft_set_thread_allocator(&mem);
+    BuffetColumn zcol = {0};
+    list = bft_column_views(&zcol, &cnt);
+    assert (!list);
+    assert_int (cnt, 0);
+    assert (bft_column_append(&zcol, alpha, 0));
+    assert (bft_column_append(&zcol, alpha, 3));
+    Buffet vue = bft_column_get(&zcol, 1);
+    check_props(&vue, 0, 3);
+    bft_column_free(&zcol);
+    bft_set_thread_allocator(NULL);
+    assert_int (memcnt.live, 0);
+}
+
+void dict()
+{
+    // N sorted keys "dir/<i/10>/file<i%10>" and one long key
+    enum {N = 100};
+    Buffet keys[N+1];
+    char tmp[400];
+    for (int i = 0; i < N; ++i) {
+        int len = sprintf(tmp, "dir/%d/file%d", i/10, i%10);
+        keys[i] = bft_memcopy(tmp, len);
+    }
+    memset(tmp, 'z', 300);
+    keys[N] = bft_memcopy(tmp, 300);
+
+    BuffetDict dict = bft_dict_from(keys, N+1);
+    assert_int (bft_dict_count(&dict), N+1);
+    assert (bft_dict_retained(&dict) < N*10);
+
+    for (int i = 0; i <= N; ++i) {
+        assert_int (bft_dict_find(&dict, &keys[i]), i);
+        Buffet key = bft_dict_get(&dict, i);
+        assert_int (bft_cmp(&key, &keys[i]), 0);
+        bft_free(&key);
+    }
+
+    // absent
+    Buffet miss[] = {
+        bft_memview("a", 1), bft_memview("dir/1", 5), 
+        bft_memview("dir/1/file10", 12), bft_memview("zzz", 3),
+    };
+    for (int i = 0; i < 4; ++i) assert_int (bft_dict_find(&dict, &miss[i]), -1);
+    Buffet out = bft_dict_get(&dict, N+1);
+    check_zero(&out);
+
+    // prefix ranges
+    long first;
+    Buffet pre = bft_memview("dir/2/", 6);
+    assert_int (bft_dict_prefix(&dict, &pre, &first), 10);
+    assert_int (first, 20);
+    pre = bft_memview("dir/", 4);
+    assert_int (bft_dict_prefix(&dict, &pre, &first), N);
+    assert_int (first, 0);
+    pre = bft_memview("dir/9/file9", 11);
+    assert_int (bft_dict_prefix(&dict, &pre, &first), 1);
+    assert_int (first, N-1);
+    pre = bft_memview("dis", 3);
+    assert_int (bft_dict_prefix(&dict, &pre, &first), 0);
+    pre = bft_memview("", 0);
+    assert_int (bft_dict_prefix(&dict, &pre, &first), N+1);
+
+    bft_dict_free(&dict);
+    assert (!dict.data && !dict.cnt);
+
+    // unsorted
+    dict = bft_dict_from(keys+1, 2);
+    assert_int (bft_dict_count(&dict), 2);
+    bft_dict_free(&dict);
+    Buffet unsorted[] = {keys[2], keys[1]};
+    dict = bft_dict_from(unsorted, 2);
+    assert_int (bft_dict_count(&dict), 0);
+    assert_int (bft_dict_find(&dict, &keys[1]), -1);
+    assert_int (bft_dict_prefix(&dict, &pre, &first), 0);
+    bft_dict_free(&dict);
+
+    for (int i = 0; i <= N; ++i) bft_free(&keys[i]);
+}
+
+typedef struct {
+    Buffet *keys;
+    int cnt;
+    int stop;
+} ArtCheck;
+
+static bool art_visit (const Buffet *key, void *val, void *ctx) 
+{
+    ArtCheck *check = ctx;
+    assert_int (bft_cmp(key, &check->keys[check->cnt]), 0);
+    assert_int ((intptr_t)val, check->cnt+1);
+    return ++check->cnt != check->stop;
+}
+
+static int art_cmp (const void *a, const void *b) {
+    return bft_cmp(a, b);
+}
+
+static bool art_keydata (const Buffet *key, void *val, void *ctx) 
+{
+    (void)val;
+    *(const char**)ctx = bft_data(key);
+    return true;
+}
+
+void art()
+{
+    // routes sharing prefixes, long paths, a byte fanout growing to Node256
+    enum {N = 300};
+    Buffet keys[N];
+    char tmp[200];
+    int cnt = 0;
+    keys[cnt++] = bft_memview("", 0);
+    keys[cnt++] = bft_memview("/", 1);
+    keys[cnt++] = bft_memview("/api", 4);
+    keys[cnt++] = bft_memview("/api/v1", 7);
+    keys[cnt++] = bft_memview("/api/v1/users/list", 18);
+    keys[cnt++] = bft_memview("/api/v2", 7);
+    keys[cnt++] = bft_memcopy(alpha, 100);
+    keys[cnt++] = bft_memcopy(alpha, 60);
+    keys[cnt++] = bft_memcopy(alpha+1, 90);
+    for (int b = 1; b < 256; ++b) {
+        tmp[0] = 'x'; 
+        tmp[1] = b;
+        keys[cnt++] = bft_memcopy(tmp, 2 + (b%3));
+    }
+    qsort(keys, cnt, sizeof(Buffet), art_cmp);
+
+    BuffetArt art = {0};
+    for (int i = 0; i < cnt; ++i) 
+        assert (bft_art_insert(&art, &keys[i], (void*)(intptr_t)(i+1)));
+    assert_int (bft_art_count(&art), cnt);
+
+    for (int i = 0; i < cnt; ++i) 
+        assert_int ((intptr_t)bft_art_find(&art, &keys[i]), i+1);
+
+    // replace
+    assert (bft_art_insert(&art, &keys[3], (void*)(intptr_t)1000));
+    assert_int (bft_art_count(&art), cnt);
+    assert_int ((intptr_t)bft_art_find(&art, &keys[3]), 1000);
+    assert (bft_art_insert(&art, &keys[3], (void*)(intptr_t)4));
+
+    // absent
+    Buffet miss = bft_memview("/api/v", 6);
+    assert (!bft_art_find(&art, &miss));
+    miss = bft_memcopy(alpha, 99);
+    assert (!bft_art_find(&art, &miss));
+    bft_free(&miss);
+
+    // longest prefix
+    size_t matchlen;
+    Buffet query = bft_memview("/api/v1/users/new", 17);
+    void *val = bft_art_longest(&art, &query, &matchlen);
+    assert_int (matchlen, 7);
+    Buffet v1 = bft_memview("/api/v1", 7);
+    assert (val == bft_art_find(&art, &v1));
+    assert (bft_art_longest(&art, &v1, &matchlen) == val);
+    assert_int (matchlen, 7);
+    query = bft_memview("/ap", 3);
+    bft_art_longest(&art, &query, &matchlen);
+    assert_int (matchlen, 1);
+    query = bft_memcopy(alpha, 80);
+    bft_art_longest(&art, &query, &matchlen);
+    assert_int (matchlen, 60);
+    bft_free(&query);
+
+    // ordered iteration
+    ArtCheck check = {keys, 0, -1};
+    assert_int (bft_art_each(&art, NULL, art_visit, &check), cnt);
+    assert_int (check.cnt, cnt);
+
+    check = (ArtCheck){keys, 0, 10};
+    assert_int (bft_art_each(&art, NULL, art_visit, &check), 10);
+
+    Buffet prefix = bft_memview("/api/v", 6);
+    int first = 0;
+    while (bft_cmp(&keys[first], &prefix) < 0) ++first;
+    check = (ArtCheck){keys, first, -1};
+    assert_int (bft_art_each(&art, &prefix, art_visit, &check), 3);
+    prefix = bft_memview("x", 1);
+    assert_int (bft_art_each(&art, &prefix, art_visit, &(ArtCheck){keys, cnt-255, -1}), 255);
+    prefix = bft_memview("/b", 2);
+    assert_int (bft_art_each(&art, &prefix, art_visit, &check), 0);
+
+    // keys are kept by the tree
+    for (int i = 0; i < cnt; ++i) bft_free(&keys[i]);
+    query = bft_memcopy(alpha, 100);
+    assert (bft_art_find(&art, &query));
+    bft_free(&query);
+
+    bft_art_free(&art);
+    assert (!art.root && !art.cnt);
+    assert (!bft_art_find(&art, &query));
+
+    // a short key does not pin its big store, a full one shares it
+    const char *kept = NULL;
+    Buffet big = bft_new(8*alphalen);
+    Buffet full = bft_memcopy(alpha, alphalen-1);
+    bft_append(&big, alpha, alphalen-1);
+    assert (bft_art_insert(&art, &big, (void*)1));
+    bft_art_each(&art, NULL, art_keydata, &kept);
+    assert (kept != bft_data(&big));
+    bft_art_free(&art);
+    assert (bft_art_insert(&art, &full, (void*)1));
+    bft_art_each(&art, NULL, art_keydata, &kept);
+    assert (kept == bft_data(&full));
+    bft_free(&full);
+    assert (bft_art_find(&art, &big));
+    bft_free(&big);
+    bft_art_free(&art);
+}
+
 void zero()
 {
     Buffet buf = BUFFET_ZERO;
@@ -696,6 +1559,177 @@ LOG("%.16s",  "> " #name " ================"); \
 name(); \
 LOG("%s OK", #name); 
 
+//=============================================================================
+// naive split count, non-overlapping as bft_split
+static int split_count (const char *src, size_t srclen, const char *sep, size_t seplen)
+{
+    int cnt = 1;
+    for (size_t i = 0; i+seplen <= srclen;) {
+        if (!memcmp(src+i, sep, seplen)) {++cnt; i += seplen;} else ++i;
+    }
+    return cnt;
+}
+
+// every kernel tier finds the same parts
+void isa()
+{
+    const char *seps[] = {",", "ab", "a,b", "abab", "aaaaaaaaaaaaaaaaab", 
+        "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbba"};
+    const char *tiers[] = {"scalar", "sse2", "avx2"};
+    char src[1000];
+    unsigned seed = 1;
+    for (size_t i = 0; i < sizeof(src); ++i) {
+        seed = seed*1103515245 + 12345;
+        src[i] = "ab,"[(seed >> 16) % 3];
+    }
+    char runs[1000];
+    memset(runs, 'b', sizeof(runs));
+
+    assert (!bft_set_isa("vax"));
+
+    for (int t = 0; t < 3; ++t) {
+        if (!bft_set_isa(tiers[t])) continue;
+        assert_str (bft_isa(), tiers[t]);
+
+        for (size_t k = 0; k < sizeof(seps)/sizeof(*seps); ++k) {
+            const char *sep = seps[k];
+            const size_t seplen = strlen(sep);
+            for (size_t len = 0; len <= sizeof(src); len += 97) {
+                int cnt;
+                Buffet *parts = bft_split(src, len, sep, seplen, &cnt);
+                assert_int (cnt, split_count(src, len, sep, seplen));
+                const char *end = src;
+                for (int i = 0; i < cnt; ++i) {
+                    assert (bft_data(&parts[i]) >= end);
+                    end = bft_data(&parts[i]) + bft_len(&parts[i]);
+                    if (i < cnt-1) assert (!memcmp(end, sep, seplen));
+                }
+                assert (end == src+len);
+                bft_freelist(parts, cnt);
+
+                // periodic input, run of the last byte
+                runs[len ? len-1 : 0] = 'a';
+                parts = bft_split(runs, len, sep, seplen, &cnt);
+                assert_int (cnt, split_count(runs, len, sep, seplen));
+                bft_freelist(parts, cnt);
+                runs[len ? len-1 : 0] = 'b';
+            }
+        }
+
+        // Node16 lookups
+        BuffetArt art = {0};
+        Buffet keys[16];
+        char key[2] = {'k'};
+        for (int i = 0; i < 16; ++i) {
+            key[1] = 'a' + 3*i;
+            keys[i] = bft_memcopy(key, 2);
+            bft_art_insert(&art, &keys[i], (void*)(intptr_t)(i+1));
+        }
+        for (int i = 0; i < 16; ++i) {
+            assert_int ((intptr_t)bft_art_find(&art, &keys[i]), i+1);
+            key[1] = 'a' + 3*i + 1;
+            Buffet miss = bft_memview(key, 2);
+            assert (!bft_art_find(&art, &miss));
+            bft_free(&keys[i]);
+        }
+        bft_art_free(&art);
+    }
+
+    assert (bft_set_isa(NULL));
+}
+
+//=============================================================================
+// Best of 5 cpu times of a split, checking the parts count.
+// With BUFFET_STATS, also the bytes inspected by the search, in `inspected`.
+static double split_time (const char *src, size_t len, const char *sep, 
+    size_t seplen, int expcnt, size_t *inspected)
+{
+    double best = 0;
+    for (int r = 0; r < 5; ++r) {
+        struct timespec beg, end;
+        int cnt;
+        #if BUFFET_STATS
+        const BuffetStats before = bft_stats_get();
+        #endif
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &beg);
+        Buffet *parts = bft_split(src, len, sep, seplen, &cnt);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+        #if BUFFET_STATS
+        *inspected = bft_stats_get().search_bytes - before.search_bytes;
+        #else
+        *inspected = 0;
+        #endif
+        assert_int (cnt, expcnt);
+        bft_freelist(parts, cnt);
+        const double t = (end.tv_sec-beg.tv_sec)*1e9 + (end.tv_nsec-beg.tv_nsec);
+        if (!r || t < best) best = t;
+    }
+    return best;
+}
+
+// Split time must scale linearly with the input at any kernel tier, 
+// whatever the search does inside : on 16x the input, quadratic takes 256x.
+// Fails past 4x linear, plus 0.5ms for timer grain and caches.
+// With BUFFET_STATS, the bytes inspected are checked too, exactly.
+// (ASan's memmem interceptor rescans the haystack : timing is skipped.)
+#if defined(__SANITIZE_ADDRESS__)
+#define ADV_TIMED 0
+#else
+#define ADV_TIMED 1
+#endif
+
+void adversarial()
+{
+    #define ADV_LEN (1<<18)
+    #define ADV_TIERS 3 // 1x 4x 16x
+    const char *tiers[] = {"scalar", "sse2", "avx2"};
+    char *src = malloc(ADV_LEN);
+    char *sep = malloc(ADV_LEN);
+
+    const char *abc = "ab,c,";
+    assert (bft_find(abc, 5, ",", 1) == abc+2);
+    assert (bft_find(abc, 5, ",c", 2) == abc+2);
+    assert (!bft_find(abc, 2, ",", 1));
+    assert (!bft_find(abc, 5, "", 0));
+
+    for (int t = 0; t < 3; ++t) {
+        if (!bft_set_isa(tiers[t])) continue;
+
+        for (int kind = 0; kind < ADVERSARIES; ++kind) {
+            double times[ADV_TIERS];
+            size_t len = ADV_LEN >> 2*(ADV_TIERS-1);
+
+            for (int i = 0; i < ADV_TIERS; ++i, len *= 4) {
+                size_t seplen, inspected;
+                const int expcnt = adversary(kind, src, len, sep, &seplen);
+                times[i] = split_time(src, len, sep, seplen, expcnt, &inspected);
+                #if BUFFET_STATS
+                if (inspected > 4*len) {
+                    ERR("%s kind %d : %zu bytes inspected in %zu\n", 
+                        tiers[t], kind, inspected, len);
+                    assert (0);
+                }
+                #endif
+            }
+
+            for (int i = 1; ADV_TIMED && i < ADV_TIERS; ++i) {
+                const double scale = 1 << 2*i;
+                if (times[i] > 4*scale*times[0] + 5e5) {
+                    ERR("%s kind %d : %.0fns, then %.0fns on %.0fx the input\n", 
+                        tiers[t], kind, times[0], times[i], scale);
+                    assert (0);
+                }
+            }
+        }
+    }
+
+    assert (bft_set_isa(NULL));
+    free(src);
+    free(sep);
+    #undef ADV_LEN
+    #undef ADV_TIERS
+}
+
 int main()
 {
     repeatat(alpha, alphalen, ALPHA64);
@@ -704,15 +1738,31 @@ int main()
     run(zero);
     run(new);
     run(memcopy);
+    run(memcopy_many);
     run(memview);
     run(dup);
+    run(inlined);
     run(copy);
     run(view);
+    run(views);
     run(cat);
     run(append);
+    run(edit);
+    run(normalize);
     run(splitjoin);
+    run(split_bounded);
+    run(splitbuf);
     run(free_);
     run(cmp);
+    run(compact);
+    run(stats);
+    run(allocator);
+    run(compact16);
+    run(column);
+    run(dict);
+    run(art);
+    run(isa);
+    run(adversarial);
     LOG("unit tests OK");
 
     return 0;
@@ -0,0 +1,241 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <cstdio>
+#include <ranges>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "buffet.hpp"
+
+using namespace std;
+
+static const char *alpha = "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-_";
+
+#define check(buf, off, len) \
+    assert ((string_view)(buf) == string_view(alpha+(off), (len)))
+
+static void construct()
+{
+    bft::Buffet zero;
+    assert (zero.empty());
+    check (zero, 0, 0);
+
+    bft::Buffet sso(alpha, 8);
+    bft::Buffet own(alpha, 40);
+    bft::Buffet vue = bft::Buffet::memview(alpha, 40);
+    check (sso, 0, 8);
+    check (own, 0, 40);
+    check (vue, 0, 40);
+    assert (own[3] == 'd');
+
+    bft::Buffet sv(string_view(alpha, 30));
+    check (sv, 0, 30);
+
+    ::Buffet raw = bft_memcopy(alpha, 30);
+    bft::Buffet adopted = bft::Buffet::adopt(raw);
+    check (adopted, 0, 30);
+    raw = adopted.release();
+    assert (adopted.empty());
+    bft_free(&raw);
+}
+
+static void copymove()
+{
+    bft::Buffet own(alpha, 64); // OWN at any BUFFET_SIZE
+    const char *data = own.data();
+
+    // copy shares the store
+    bft::Buffet cpy = own;
+    assert (cpy.data() == data);
+
+    // move transfers
+    bft::Buffet moved = std::move(own);
+    assert (moved.data() == data);
+    assert (own.empty());
+
+    cpy = moved;
+    cpy = std::move(moved);
+    assert (cpy.data() == data);
+    assert (moved.empty());
+    cpy = cpy;
+    check (cpy, 0, 64);
+
+    // views outlive their source
+    bft::Buffet ref = cpy.view(2, 30);
+    cpy = bft::Buffet();
+    check (ref, 2, 30);
+
+    // SSO with views is dup'ed, keeping views valid
+    bft::Buffet sso(alpha, 8);
+    bft::Buffet ssv = sso.view(1, 4);
+    bft::Buffet sso2 = std::move(sso);
+    check (sso2, 0, 8);
+    check (sso, 0, 8);
+    check (ssv, 1, 4);
+
+    vector<bft::Buffet> list;
+    for (int i = 0; i < 100; ++i) list.emplace_back(alpha+i%32, 30);
+    for (int i = 0; i < 100; ++i) check(list[i], i%32, 30);
+}
+
+static void compare()
+{
+    bft::Buffet a(alpha, 8);
+    bft::Buffet b(alpha, 40);
+    bft::Buffet c(alpha+1, 8);
+
+    assert (a == a);
+    assert (a != b);
+    assert (a < b);
+    assert (b < c);
+    assert (a == string_view(alpha, 8));
+    assert (a < string_view(alpha, 9));
+    assert ((a <=> b) == (bft_cmp(a.get(), b.get()) <=> 0));
+
+    unordered_set<bft::Buffet> set;
+    set.insert(a);
+    set.insert(b);
+    set.insert(bft::Buffet(alpha, 8));
+    assert (set.size() == 2);
+    assert (set.count(bft::Buffet::memview(alpha, 40)));
+}
+
+static void append()
+{
+    bft::Buffet buf(alpha, 8);
+    buf.append(alpha+8, 8);
+    buf += string_view(alpha+16, 24);
+    check (buf, 0, 40);
+
+    bft::Buffet part = buf.copy(4, 30);
+    check (part, 4, 30);
+}
+
+static void split()
+{
+    auto parts = [](string_view src, string_view sep) {
+        vector<string_view> ret;
+        for (auto part : bft::split_view(src, sep)) ret.push_back(part);
+        return ret;
+    };
+
+    using list = vector<string_view>;
+    assert (parts("a,bc,,d", ",") == (list{"a", "bc", "", "d"}));
+    assert (parts(",a,", ",") == (list{"", "a", ""}));
+    assert (parts("a::b:c", "::") == (list{"a", "b:c"}));
+    assert (parts("abc", ",") == (list{"abc"}));
+    assert (parts("abc", "") == (list{"abc"}));
+    assert (parts("", ",") == (list{""}));
+
+    // long partial matches
+    const string runs(1000, 'a');
+    assert (parts(runs+"b"+runs, string(100, 'a')+"b").size() == 2);
+
+    // parts match bft_split
+    bft::Buffet src(alpha, 64);
+    int cnt;
+    ::Buffet *ref = bft_split(alpha, 64, "9", 1, &cnt);
+    int i = 0;
+    for (auto part : bft::split_view(src, "9")) {
+        assert (part == string_view(bft_data(&ref[i]), bft_len(&ref[i])));
+        assert (part.data() >= src.data() && part.data() <= src.data()+64);
+        ++i;
+    }
+    assert (i == cnt);
+    bft_freelist(ref, cnt);
+
+    // composition
+    auto lens = bft::split_view("ab,,cde,f", ",")
+              | views::filter([](string_view p) {return !p.empty();})
+              | views::transform([](string_view p) {return p.size();});
+    vector<size_t> got;
+    for (size_t len : lens) got.push_back(len);
+    assert ((got == vector<size_t>{2, 3, 1}));
+
+    vector<bft::Buffet> vues;
+    for (auto vue : bft::split_view(src, "9") | views::transform(
+            [](string_view p) {return bft::Buffet::memview(p);}))
+        vues.push_back(std::move(vue));
+    assert (vues.size() == (size_t)cnt);
+    check (vues[0], 0, 35);
+
+    static_assert (ranges::forward_range<bft::split_view>);
+    static_assert (ranges::view<bft::split_view>);
+
+    // temporaries owning their bytes are rejected, borrowed sources accepted
+    static_assert (!is_constructible_v<bft::split_view, string, string_view>);
+    static_assert (!is_constructible_v<bft::split_view, bft::Buffet, string_view>);
+    static_assert (is_constructible_v<bft::split_view, string&, string_view>);
+    static_assert (is_constructible_v<bft::split_view, const string&, string_view>);
+    static_assert (is_constructible_v<bft::split_view, string_view, string_view>);
+    static_assert (is_constructible_v<bft::split_view, const char*, string_view>);
+    static_assert (is_constructible_v<bft::split_view, const char(&)[4], string_view>);
+}
+
+// memory resource counting its live blocks
+struct CountResource : std::pmr::memory_resource {
+    int live = 0;
+    void* do_allocate (size_t size, size_t align) override {
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(size, align);
+    }
+    void do_deallocate (void *ptr, size_t size, size_t align) override {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(ptr, size, align);
+    }
+    bool do_is_equal (const memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+static void resource()
+{
+    CountResource res;
+    bft::PmrAllocator mem(&res);
+    {
+        bft::AllocatorScope scope(mem);
+        assert (bft_get_allocator() == mem.get());
+
+        bft::Buffet sso(alpha, 8);
+        assert (res.live == 0);
+        bft::Buffet own(alpha, 62); // OWN at any BUFFET_SIZE
+        assert (res.live == 1);
+        own += string_view(alpha+62, 2);
+        check (own, 0, 64);
+        assert (res.live == 1);
+        {
+            bft::AllocatorScope inner(nullptr);
+            bft::Buffet sys(alpha, 30);
+            assert (res.live == 1);
+        }
+        assert (bft_get_allocator() == mem.get());
+    }
+    assert (res.live == 0);
+    assert (bft_get_allocator() != mem.get());
+
+    // stores outlive the scope, released by their resource
+    std::pmr::monotonic_buffer_resource arena;
+    bft::PmrAllocator arenamem(&arena);
+    vector<bft::Buffet> list;
+    {
+        bft::AllocatorScope scope(arenamem);
+        for (int i = 0; i < 10; ++i) list.emplace_back(alpha+i, 40);
+    }
+    for (int i = 0; i < 10; ++i) check (list[i], i, 40);
+}
+
+int main()
+{
+    construct();
+    copymove();
+    compare();
+    append();
+    split();
+    resource();
+    puts("C++ tests OK");
+
+    return 0;
+}
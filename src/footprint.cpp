@@ -0,0 +1,370 @@
+/*
+Memory footprint of many strings : Buffet vs std::string vs char*.
+
+usage: footprint [-d len:weight,...] [count...]
+ex:    footprint -d 8:1,64:1 1000000 10000000
+
+Each mode and count runs in its own process, so that RSS starts clean.
+Per string, in bytes :
+  handle  : the handle (Buffet, std::string, char*)
+  payload : the string length
+  header  : heap requested beyond the payload (Store header, nul, spare room)
+  slack   : malloc overhead beyond the request (chunk header, rounding)
+  total   : heap in use, handles array included
+  rss     : resident memory growth
+Then a random half is freed :
+  frag    : share of the heap held by malloc that is free
+  rss/2   : resident memory growth, per string left
+*/
+
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" {
+#include "buffet.h"
+}
+
+using namespace std;
+
+#define ALPHA64 "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+="
+#define SRCLEN (1<<20)
+static char alpha[SRCLEN];
+
+// length distribution : {length, weight}
+static vector<pair<size_t,int>> dist = {
+    {8, 5}, {16, 10}, {24, 20}, {32, 25}, {40, 20}, {48, 12}, {60, 8}
+};
+static int dist_total = 0;
+
+static inline uint64_t
+mix (uint64_t i) {
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+    return i ^ (i >> 31);
+}
+
+// length and source of string `i`, computed rather than stored
+static inline size_t
+len_at (size_t i)
+{
+    int pick = mix(i) % dist_total;
+    for (auto &d : dist) if ((pick -= d.second) < 0) return d.first;
+    return dist.back().first;
+}
+
+static inline const char*
+src_at (size_t i) {
+    return alpha + (i*7) % (SRCLEN/2);
+}
+
+// freed in the random half
+static inline bool
+dropped (size_t i) {
+    return mix(i ^ 0x5eed) & 1;
+}
+
+struct Mem {
+    size_t rss;   // resident
+    size_t inuse; // allocated by malloc
+    size_t held;  // obtained by malloc from the system
+};
+
+static Mem
+mem_now ()
+{
+    Mem ret = {};
+    struct mallinfo2 mi = mallinfo2();
+    ret.inuse = mi.uordblks + mi.hblkhd;
+    ret.held = mi.arena + mi.hblkhd;
+
+    FILE *f = fopen("/proc/self/statm", "r");
+    size_t size, resident;
+    if (f && fscanf(f, "%zu %zu", &size, &resident) == 2)
+        ret.rss = resident * sysconf(_SC_PAGESIZE);
+    if (f) fclose(f);
+
+    return ret;
+}
+
+// heap requested and payload placed on heap, as filled by each mode
+struct Acct {
+    size_t payload = 0;
+    size_t requested = 0;
+    size_t heaped = 0;
+};
+
+static void
+report (const char *mode, size_t n, size_t handle, const Acct &acct,
+    const Mem &m0, const Mem &m1, const Mem &m2, size_t left)
+{
+    const double inuse = m1.inuse - m0.inuse;
+    const double slack = inuse - (double)n*handle - acct.requested;
+    const double held = m2.held ? m2.held : 1;
+
+    printf("%-16s %11zu %7zu %8.1f %7.1f %6.1f %7.1f %7.1f %5.1f%% %7.1f\n",
+        mode, n, handle, (double)acct.payload/n,
+        (double)(acct.requested-acct.heaped)/n, slack/n, inuse/n,
+        ((double)m1.rss-m0.rss)/n,
+        100.0*(m2.held-m2.inuse)/held,
+        ((double)m2.rss-m0.rss)/(left ? left : 1));
+    fflush(stdout);
+}
+
+//=============================================================================
+// Buffets made by `make(i, acct)`, after `init(acct)`
+template<class Init, class Make>
+static void
+run_buffet (const char *mode, size_t n, Init init, Make make)
+{
+    Acct acct;
+    const Mem m0 = mem_now();
+    init(acct);
+    vector<Buffet> list;
+    list.reserve(n);
+    for (size_t i = 0; i < n; ++i) list.push_back(make(i, acct));
+    const Mem m1 = mem_now();
+
+    size_t left = n;
+    for (size_t i = 0; i < n; ++i)
+        if (dropped(i)) {bft_free(&list[i]); --left;}
+    const Mem m2 = mem_now();
+
+    report(mode, n, sizeof(Buffet), acct, m0, m1, m2, left);
+    for (auto &b : list) bft_free(&b);
+}
+
+static void
+account (Acct &acct, const Buffet &buf)
+{
+    const size_t len = bft_len(&buf);
+    acct.payload += len;
+    if (size_t ret = bft_retained(&buf)) {
+        acct.requested += ret;
+        acct.heaped += len;
+    }
+}
+
+static void
+buffet_memcopy (size_t n)
+{
+    run_buffet("buffet memcopy", n, [](Acct&) {}, [](size_t i, Acct &acct) {
+        Buffet ret = bft_memcopy(src_at(i), len_at(i));
+        account(acct, ret);
+        return ret;
+    });
+}
+
+// views of one store holding all payloads
+static void
+buffet_view (size_t n)
+{
+    Buffet src;
+    size_t off = 0;
+
+    auto init = [&](Acct &acct) {
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i) total += len_at(i);
+        src = bft_new(total);
+        for (size_t i = 0; i < n; ++i) bft_append(&src, src_at(i), len_at(i));
+        acct.requested = bft_retained(&src);
+        acct.heaped = total;
+    };
+
+    run_buffet("buffet view", n, init, [&](size_t i, Acct &acct) {
+        const size_t len = len_at(i);
+        Buffet ret = bft_view(&src, off, len);
+        off += len;
+        acct.payload += len;
+        if (i == n-1) bft_free(&src); // the views keep the store
+        return ret;
+    });
+}
+
+// concatenation of a view and a byte array
+static void
+buffet_cat (size_t n)
+{
+    run_buffet("buffet cat", n, [](Acct&) {}, [](size_t i, Acct &acct) {
+        const char *src = src_at(i);
+        const size_t len = len_at(i);
+        Buffet head = bft_memview(src, len/2);
+        Buffet ret;
+        bft_cat(&ret, &head, src+len/2, len-len/2);
+        account(acct, ret);
+        return ret;
+    });
+}
+
+//=============================================================================
+static void
+cpp_string (size_t n)
+{
+    Acct acct;
+    const Mem m0 = mem_now();
+    vector<string> list;
+    list.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        list.emplace_back(src_at(i), len_at(i));
+        const string &s = list.back();
+        acct.payload += s.size();
+        // out of the handle : heap
+        if (s.data() < (const char*)&s || s.data() >= (const char*)(&s+1)) {
+            acct.requested += s.capacity()+1;
+            acct.heaped += s.size();
+        }
+    }
+    const Mem m1 = mem_now();
+
+    size_t left = n;
+    for (size_t i = 0; i < n; ++i)
+        if (dropped(i)) {string().swap(list[i]); --left;}
+    const Mem m2 = mem_now();
+
+    report("std::string", n, sizeof(string), acct, m0, m1, m2, left);
+}
+
+static void
+cpp_view (size_t n)
+{
+    Acct acct;
+    const Mem m0 = mem_now();
+    string src;
+    for (size_t i = 0; i < n; ++i) src.append(src_at(i), len_at(i));
+    acct.requested = src.capacity()+1;
+    acct.heaped = src.size();
+
+    vector<string_view> list;
+    list.reserve(n);
+    size_t off = 0;
+    for (size_t i = 0; i < n; ++i) {
+        list.emplace_back(src.data()+off, len_at(i));
+        off += len_at(i);
+        acct.payload += len_at(i);
+    }
+    const Mem m1 = mem_now();
+
+    // views own nothing : the source stays whole
+    size_t left = n;
+    for (size_t i = 0; i < n; ++i) if (dropped(i)) {list[i] = {}; --left;}
+    const Mem m2 = mem_now();
+
+    report("std::string_view", n, sizeof(string_view), acct, m0, m1, m2, left);
+}
+
+static void
+c_string (size_t n)
+{
+    Acct acct;
+    const Mem m0 = mem_now();
+    vector<char*> list;
+    list.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t len = len_at(i);
+        char *s = (char*)malloc(len+1);
+        memcpy(s, src_at(i), len);
+        s[len] = 0;
+        list.push_back(s);
+        acct.payload += len;
+        acct.requested += len+1;
+        acct.heaped += len;
+    }
+    const Mem m1 = mem_now();
+
+    size_t left = n;
+    for (size_t i = 0; i < n; ++i)
+        if (dropped(i)) {free(list[i]); list[i] = NULL; --left;}
+    const Mem m2 = mem_now();
+
+    report("char*", n, sizeof(char*), acct, m0, m1, m2, left);
+    for (auto s : list) free(s);
+}
+
+//=============================================================================
+static bool
+parse_dist (char *arg)
+{
+    dist.clear();
+    for (char *tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+        size_t len;
+        int weight;
+        if (sscanf(tok, "%zu:%d", &len, &weight) != 2 || weight <= 0
+            || len >= SRCLEN/2) return false;
+        dist.push_back({len, weight});
+    }
+    return !dist.empty();
+}
+
+// a positive decimal count
+static bool
+parse_count (const char *arg, size_t *count)
+{
+    if (*arg < '0' || *arg > '9') return false;
+    char *end;
+    errno = 0;
+    *count = strtoull(arg, &end, 10);
+    return !*end && !errno && *count;
+}
+
+static int
+usage ()
+{
+    fprintf(stderr, "usage: footprint [-d len:weight,...] [count...]\n");
+    return 1;
+}
+
+int main (int argc, char **argv)
+{
+    vector<size_t> counts;
+
+    for (int i = 1; i < argc; ++i) {
+        size_t n;
+        if (!strcmp(argv[i], "-d") && i+1 < argc) {
+            if (!parse_dist(argv[++i])) {
+                fprintf(stderr, "bad distribution, expected len:weight,...\n");
+                return usage();
+            }
+        } else if (parse_count(argv[i], &n)) {
+            counts.push_back(n);
+        } else {
+            fprintf(stderr, "bad count '%s'\n", argv[i]);
+            return usage();
+        }
+    }
+    if (counts.empty()) counts = {1000000, 10000000};
+
+    for (auto &d : dist) dist_total += d.second;
+    for (size_t i = 0; i < SRCLEN; ++i) alpha[i] = ALPHA64[i%64];
+
+    void (*modes[])(size_t) = {buffet_memcopy, buffet_view, buffet_cat,
+        cpp_string, cpp_view, c_string};
+
+    printf("%-16s %11s %7s %8s %7s %6s %7s %7s %6s %7s\n", "mode", "strings",
+        "handle", "payload", "header", "slack", "total", "rss", "frag", "rss/2");
+    fflush(stdout); // not to be inherited by children
+
+    for (auto n : counts) {
+        for (auto mode : modes) {
+            pid_t pid = fork();
+            if (!pid) {
+                mode(n);
+                _exit(0);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status))
+                printf("(mode failed, out of memory ?)\n");
+        }
+        puts("");
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/*
+Contention benchmark : threads sharing stores.
+Built against a `BUFFET_THREADSAFE` lib (atomic refcounts).
+
+  SHARED_*   : all threads dup, view and free one hot Store
+  PRIVATE_*  : each thread on its own Store, for reference
+  HANDOFF    : thread pairs passing Buffets through a ring
+  *_shared_ptr : the same with std::shared_ptr, whose count is atomic too
+
+Counters : items_per_second over all threads, and when perf events are
+available, cache and L1d read misses per operation.
+*/
+
+#include <benchmark/benchmark.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include "buffet.h"
+}
+
+using namespace std;
+
+#define ALPHA64 "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+="
+static const char *alpha = ALPHA64;
+
+static const int maxthreads = max(2u, thread::hardware_concurrency());
+
+//=============================================================================
+// Per-thread hardware counters, through perf_event_open.
+// Absent (e.g. in containers, or perf_event_paranoid > 2), nothing is reported.
+class PerfMisses {
+
+public:
+
+    PerfMisses ()
+    {
+        cache = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        l1d = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+
+    ~PerfMisses () {
+        if (cache >= 0) close(cache);
+        if (l1d >= 0) close(l1d);
+    }
+
+    // add counts since construction to `state`, summed over threads
+    void report (benchmark::State &state)
+    {
+        using benchmark::Counter;
+        if (cache >= 0)
+            state.counters["misses/op"] = Counter(read(cache), Counter::kAvgIterations);
+        if (l1d >= 0)
+            state.counters["l1d-misses/op"] = Counter(read(l1d), Counter::kAvgIterations);
+    }
+
+private:
+
+    int cache, l1d;
+
+    static int open (uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // this thread, any cpu
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    static double read (int fd) {
+        uint64_t n = 0;
+        return ::read(fd, &n, sizeof(n)) == sizeof(n) ? n : 0;
+    }
+};
+
+#define PERF_BEGIN PerfMisses _perf;
+#define PERF_END \
+    _perf.report(state); \
+    state.SetItemsProcessed(state.iterations());
+
+//=============================================================================
+static Buffet shared;
+static shared_ptr<string> shared_ptr_src;
+
+static void
+SHARED_dup (benchmark::State& state)
+{
+    if (!state.thread_index()) shared = bft_memcopy(alpha, 64);
+    PERF_BEGIN
+
+    for (auto _ : state) {
+        Buffet cpy = bft_dup(&shared);
+        benchmark::DoNotOptimize(cpy);
+        bft_free(&cpy);
+    }
+
+    PERF_END
+    if (!state.thread_index()) bft_free(&shared);
+}
+
+static void
+SHARED_view (benchmark::State& state)
+{
+    if (!state.thread_index()) shared = bft_memcopy(alpha, 64);
+    PERF_BEGIN
+    size_t i = 0;
+
+    for (auto _ : state) {
+        Buffet ref = bft_view(&shared, i%32, 32);
+        benchmark::DoNotOptimize(ref);
+        bft_free(&ref);
+        ++i;
+    }
+
+    PERF_END
+    if (!state.thread_index()) bft_free(&shared);
+}
+
+static void
+SHARED_shared_ptr (benchmark::State& state)
+{
+    if (!state.thread_index()) shared_ptr_src = make_shared<string>(alpha, 64);
+    PERF_BEGIN
+
+    for (auto _ : state) {
+        shared_ptr<string> cpy = shared_ptr_src;
+        benchmark::DoNotOptimize(cpy);
+    }
+
+    PERF_END
+    if (!state.thread_index()) shared_ptr_src.reset();
+}
+
+static void
+PRIVATE_dup (benchmark::State& state)
+{
+    Buffet own = bft_memcopy(alpha, 64);
+    PERF_BEGIN
+
+    for (auto _ : state) {
+        Buffet cpy = bft_dup(&own);
+        benchmark::DoNotOptimize(cpy);
+        bft_free(&cpy);
+    }
+
+    PERF_END
+    bft_free(&own);
+}
+
+static void
+PRIVATE_view (benchmark::State& state)
+{
+    Buffet own = bft_memcopy(alpha, 64);
+    PERF_BEGIN
+    size_t i = 0;
+
+    for (auto _ : state) {
+        Buffet ref = bft_view(&own, i%32, 32);
+        benchmark::DoNotOptimize(ref);
+        bft_free(&ref);
+        ++i;
+    }
+
+    PERF_END
+    bft_free(&own);
+}
+
+//=============================================================================
+// Even threads produce views of the shared Store, odd threads free them,
+// through a single producer, single consumer ring per pair.
+#define RING_SIZE 1024
+
+struct alignas(64) Ring {
+    Buffet slots[RING_SIZE];
+    alignas(64) atomic<size_t> head; // next push
+    alignas(64) atomic<size_t> tail; // next pop
+};
+
+static Ring *rings;
+
+static void
+HANDOFF (benchmark::State& state)
+{
+    const int idx = state.thread_index();
+    const int pairs = state.threads()/2;
+    if (!idx) {
+        shared = bft_memcopy(alpha, 64);
+        rings = new Ring[pairs];
+        for (int p = 0; p < pairs; ++p) rings[p].head = rings[p].tail = 0;
+    }
+    PERF_BEGIN
+    Ring *ring = nullptr; // set by thread 0 until the loop starts
+    size_t i = 0;
+
+    for (auto _ : state) {
+        if (!ring) ring = &rings[idx/2];
+        if (idx % 2 == 0) {
+            const size_t head = ring->head.load(memory_order_relaxed);
+            while (head - ring->tail.load(memory_order_acquire) >= RING_SIZE)
+                this_thread::yield();
+            ring->slots[head % RING_SIZE] = bft_view(&shared, i%32, 32);
+            ring->head.store(head+1, memory_order_release);
+        } else {
+            const size_t tail = ring->tail.load(memory_order_relaxed);
+            while (ring->head.load(memory_order_acquire) == tail)
+                this_thread::yield();
+            bft_free(&ring->slots[tail % RING_SIZE]);
+            ring->tail.store(tail+1, memory_order_release);
+        }
+        ++i;
+    }
+
+    PERF_END
+    if (!idx) {
+        delete[] rings;
+        bft_free(&shared);
+    }
+}
+
+//=============================================================================
+#define THREADS(fn) BENCHMARK(fn)->ThreadRange(1, maxthreads)->UseRealTime();
+
+THREADS (SHARED_dup);
+THREADS (SHARED_view);
+THREADS (SHARED_shared_ptr);
+THREADS (PRIVATE_dup);
+THREADS (PRIVATE_view);
+BENCHMARK(HANDOFF)->DenseThreadRange(2, maxthreads, 2)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stddef.h>
 
 #define min(a,b) ({ \
 __typeof__ (a) _a = (a); \
@@ -98,16 +99,20 @@ splitlen (const char* src, size_t srclen, const char* sep, size_t seplen,
             partsmax *= 2;
             size_t newsz = partsmax * sizeof(char*);
 
+            char **grown = (char**)(local ? malloc(newsz) : realloc(parts, newsz));
+            if (!grown) {
+                // the old list stays valid : release it
+                for (int i = 0; i < curcnt; ++i) free(parts[i]);
+                if (!local) free(parts);
+                curcnt = 0; 
+                goto fin;
+            }
             if (local) {
-                parts = (char**)malloc(newsz); 
-                if (!parts) {curcnt = 0; goto fin;}
-                memcpy (parts, parts_local, curcnt * sizeof(char*));
+                memcpy (grown, parts_local, curcnt * sizeof(char*));
                 local = false;
-                parts_alloc = (char*)parts;
-            } else {
-                parts = (char**)realloc(parts, newsz); 
-                if (!parts) {curcnt = 0; goto fin;}
             }
+            parts = grown;
+            parts_alloc = (char*)parts;
         }
 
         #define TOLIST \
@@ -186,3 +191,98 @@ char*
 join (char** parts, int cnt, const char* sep) {
     return joinlen(parts, cnt, sep, strlen(sep));
 }
+
+// sds-style string, for comparison : the handle points to the data,
+// preceded by its length and capacity. Grows x2 up to 1MB, then by 1MB.
+typedef struct {
+    size_t len;
+    size_t cap;
+    char   data[];
+} SdsHead;
+
+#define SDS_HEAD(s) ((SdsHead*)((s) - offsetof(SdsHead, data)))
+#define SDS_PREALLOC (1024*1024)
+
+static char*
+sds_newlen (const char *src, size_t len)
+{
+    SdsHead *head = (SdsHead*)malloc(sizeof(SdsHead)+len+1);
+    if (!head) return NULL;
+    head->len = head->cap = len;
+    if (len) memcpy(head->data, src, len);
+    head->data[len] = 0;
+    return head->data;
+}
+
+// On failure returns NULL, and `s` stays valid.
+static char*
+sds_catlen (char *s, const char *src, size_t len)
+{
+    SdsHead *head = SDS_HEAD(s);
+    const size_t newlen = head->len + len;
+
+    if (newlen > head->cap) {
+        size_t cap = newlen < SDS_PREALLOC ? 2*newlen : newlen + SDS_PREALLOC;
+        SdsHead *grown = (SdsHead*)realloc(head, sizeof(SdsHead)+cap+1);
+        if (!grown) return NULL;
+        head = grown;
+        head->cap = cap;
+    }
+
+    memcpy(head->data + head->len, src, len);
+    head->len = newlen;
+    head->data[newlen] = 0;
+    return head->data;
+}
+
+static size_t
+sds_len (const char *s) {
+    return SDS_HEAD(s)->len;
+}
+
+static void
+sds_free (char *s) {
+    if (s) free(SDS_HEAD(s));
+}
+
+// Pathological split inputs of `len` bytes, the separator growing along so 
+// that a search in O(srclen*seplen) shows as quadratic. `sep` holds `len` 
+// bytes. Returns the parts count.
+enum {PARTIAL, PREFIX, PERIODIC, HUGESEP, EMPTIES, ADVERSARIES};
+
+static int
+adversary (int kind, char *src, size_t len, char *sep, size_t *seplen)
+{
+    const size_t m = len/64;
+    memset(src, 'a', len);
+
+    switch (kind) {
+    case PARTIAL: // first and last bytes match everywhere
+        memset(sep, 'a', m);
+        sep[m-2] = 'b';
+        *seplen = m;
+        return 1;
+    case PREFIX: // long prefix matches everywhere
+        memset(sep, 'a', m);
+        sep[m-1] = 'b';
+        *seplen = m;
+        return 1;
+    case PERIODIC:
+        for (size_t i = 0; i < len; ++i) src[i] = "ab"[i%2];
+        for (size_t i = 0; i < m; ++i) sep[i] = "ab"[i%2];
+        sep[m-2] = 'b';
+        *seplen = m;
+        return 1;
+    case HUGESEP: // half the source
+        memset(sep, 'a', len/2);
+        sep[len/2-2] = 'b';
+        *seplen = len/2;
+        return 1;
+    case EMPTIES: // far past LIST_STACK_MAX
+        memset(src, ',', len);
+        sep[0] = ',';
+        *seplen = 1;
+        return len+1;
+    }
+    return 0;
+}
@@ -1,5 +1,21 @@
 #include "utilcpp.h"
 
+vector<string>
+split_string(const string &s, const char delim)
+{
+    vector<string> parts;
+    size_t beg{};
+    size_t end{};
+
+    do {
+        end = s.find(delim, beg);
+        parts.emplace_back(s.substr(beg, end-beg));
+        beg = end + 1;
+    } while (end != string::npos);
+
+    return parts;
+}
+
 // slow.. ?
 vector<string_view>
 split_cppview(const char* src, const char* sep)
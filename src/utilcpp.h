@@ -10,7 +10,7 @@ using namespace std;
 // std::ostream& bold_off(std::ostream& os) {return os << "\e[0m";}
 
 vector<string>
-split_string(const string s, const char delim);
+split_string(const string &s, const char delim);
 
 vector<string_view>
 split_cppview(const char* src, const char* sep);